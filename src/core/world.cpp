@@ -1,5 +1,8 @@
 #include "core/world.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "core/engine.h"
 #include "components/camera_input.h"
 #include "components/transform.h"
@@ -13,6 +16,12 @@ World::World()
     paused = false;
     shouldClose = false;
 
+    fixedTimeStep = 1.0 / 60;
+    accumulator = 0;
+    timeScale = 1;
+    maxStepsPerFrame = 8;
+    interpolationAlpha = 0;
+
     window = Engine::GetWindow();
 }
 
@@ -48,6 +57,25 @@ double World::GetLastFrameTime()
 }
 
 
+void World::SetTickRate(double ticksPerSecond)
+{
+    if (ticksPerSecond > 0)
+        fixedTimeStep = 1.0 / ticksPerSecond;
+}
+
+
+void World::SetMaxStepsPerFrame(int steps)
+{
+    maxStepsPerFrame = std::max(steps, 1);
+}
+
+
+void World::SetTimeScale(double scale)
+{
+    timeScale = std::max(scale, 0.0);
+}
+
+
 void World::ComputeFrameDeltaTime()
 {
     elapsedTime = Engine::GetElapsedTime();
@@ -56,6 +84,30 @@ void World::ComputeFrameDeltaTime()
 }
 
 
+void World::RunFixedSteps()
+{
+    if (paused)
+        return;
+
+    accumulator += deltaTime * timeScale;
+
+    int maxSteps = maxStepsPerFrame * std::max(1, (int)std::ceil(timeScale));
+    int steps = 0;
+    while (accumulator >= fixedTimeStep && steps < maxSteps)
+    {
+        FixedUpdate(static_cast<float>(fixedTimeStep));
+        accumulator -= fixedTimeStep;
+        steps++;
+    }
+
+    // Could not keep up; skip ahead rather than fall further behind
+    if (accumulator >= fixedTimeStep)
+        accumulator = std::fmod(accumulator, fixedTimeStep);
+
+    interpolationAlpha = static_cast<float>(accumulator / fixedTimeStep);
+}
+
+
 void World::LoopUpdate()
 {
     // Polls and buffers the events
@@ -69,6 +121,9 @@ void World::LoopUpdate()
     // OnInputUpdate will be called each frame, the other functions are called only if an event is registered
     window->UpdateObservers();
 
+    // Fixed-rate simulation steps owed since the last frame
+    RunFixedSteps();
+
     // Frame processing
     FrameStart();
     Update(static_cast<float>(deltaTime));
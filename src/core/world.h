@@ -10,6 +10,9 @@ class World : public InputController
     virtual ~World() {}
     virtual void Init() {}
     virtual void FrameStart() {}
+    // Called zero or more times per frame, before Update, with a constant
+    // step, so simulations do not depend on the frame rate
+    virtual void FixedUpdate(float stepSeconds) {}
     virtual void Update(float deltaTimeSeconds) {}
     virtual void FrameEnd() {}
 
@@ -19,8 +22,24 @@ class World : public InputController
 
     double GetLastFrameTime();
 
+    void SetTickRate(double ticksPerSecond);
+    double GetFixedTimeStep() const { return fixedTimeStep; }
+
+    // Fixed steps allowed per frame at normal speed; the limit grows with
+    // the time scale. A frame that falls further behind drops the backlog.
+    void SetMaxStepsPerFrame(int steps);
+
+    // Simulated seconds per real second, e.g. 100 to fast-forward
+    void SetTimeScale(double scale);
+    double GetTimeScale() const { return timeScale; }
+
+    // How far into the next fixed step the current frame is, in [0, 1), to
+    // blend between the last two simulated states when rendering
+    float GetInterpolationAlpha() const { return interpolationAlpha; }
+
  private:
     void ComputeFrameDeltaTime();
+    void RunFixedSteps();
     void LoopUpdate();
 
  private:
@@ -29,4 +48,10 @@ class World : public InputController
     double deltaTime;
     bool paused;
     bool shouldClose;
+
+    double fixedTimeStep;
+    double accumulator;
+    double timeScale;
+    int maxStepsPerFrame;
+    float interpolationAlpha;
 };
@@ -0,0 +1,148 @@
+#include "lab_m1/tema2/sim/action_log.h"
+
+#include <algorithm>
+
+#include "lab_m1/tema2/sim/snapshot.h"
+
+using namespace std;
+using namespace m1;
+
+
+namespace
+{
+    const uint32_t ACTION_LOG_VERSION = 1;
+
+    // Numbered apart from the game snapshot sections, so neither file
+    // loads as the other
+    enum ActionLogSectionId : uint32_t {
+        LOG_SETTINGS = 0x100,
+        LOG_HEIGHTMAP,          // path characters, no terminator
+        LOG_ACTIONS
+    };
+
+    struct RecordedSettings
+    {
+        uint32_t seed;
+        int32_t gridWidth, gridHeight;
+        int32_t sandbox;
+        int32_t grassCost, waterCost, mountainCost, railCost, heuristicWeight;
+        float heightmapWeight;
+        float featureSize;
+        int32_t octaves;
+        float waterLevel, mountainLevel;
+        float riverWidth;
+        int32_t smoothingPasses;
+        float dt;
+        uint32_t padding;
+        uint64_t ticks;
+    };
+
+    static_assert(sizeof(PlayerAction) == 40, "actions are saved as they are");
+}
+
+
+ActionLog::ActionLog()
+{
+    dt = 0.0f;
+    ticks = 0;
+}
+
+void ActionLog::Begin(const SimConfig& simConfig, float stepSeconds)
+{
+    config = simConfig;
+    config.threads = SimConfig().threads;
+    dt = stepSeconds;
+    ticks = 0;
+    actions.clear();
+}
+
+void ActionLog::Record(const PlayerAction& action)
+{
+    actions.push_back(action);
+    actions.back().tick = ticks;
+}
+
+bool ActionLog::Save(const std::string& path) const
+{
+    RecordedSettings settings = {};
+    settings.seed = config.seed;
+    settings.gridWidth = config.gridWidth;
+    settings.gridHeight = config.gridHeight;
+    settings.sandbox = config.sandbox;
+    settings.grassCost = config.pathCosts.grass;
+    settings.waterCost = config.pathCosts.water;
+    settings.mountainCost = config.pathCosts.mountain;
+    settings.railCost = config.pathCosts.rail;
+    settings.heuristicWeight = config.pathCosts.heuristicWeight;
+    settings.heightmapWeight = config.terrain.heightmapWeight;
+    settings.featureSize = config.terrain.featureSize;
+    settings.octaves = config.terrain.octaves;
+    settings.waterLevel = config.terrain.waterLevel;
+    settings.mountainLevel = config.terrain.mountainLevel;
+    settings.riverWidth = config.terrain.riverWidth;
+    settings.smoothingPasses = config.terrain.smoothingPasses;
+    settings.dt = dt;
+    settings.ticks = ticks;
+
+    SnapshotWriter writer;
+    writer.Add(LOG_SETTINGS, &settings, 1);
+    writer.Add(LOG_HEIGHTMAP, config.terrain.heightmapPath.data(), config.terrain.heightmapPath.size());
+    writer.Add(LOG_ACTIONS, actions);
+    return writer.Write(path, ACTION_LOG_VERSION);
+}
+
+bool ActionLog::Load(const std::string& path)
+{
+    SnapshotReader reader;
+    if (!reader.Open(path, ACTION_LOG_VERSION)) return false;
+
+    const RecordedSettings* settings;
+    const char* heightmap;
+    const PlayerAction* recorded;
+    size_t count, heightmapLength, actionCount;
+    if (!reader.Find(LOG_SETTINGS, settings, count) || count != 1 ||
+        !reader.Find(LOG_HEIGHTMAP, heightmap, heightmapLength) ||
+        !reader.Find(LOG_ACTIONS, recorded, actionCount))
+    {
+        return false;
+    }
+
+    // Actions come in tick order and name cells of the recorded map, at
+    // the size TrainSim::Init gives it
+    int width = std::min(std::max((int)settings->gridWidth, TrainSim::MIN_GRID_SIZE), TrainSim::MAX_GRID_SIZE);
+    int height = std::min(std::max((int)settings->gridHeight, TrainSim::MIN_GRID_SIZE), TrainSim::MAX_GRID_SIZE);
+    for (size_t k = 0; k < actionCount; k++) {
+        const PlayerAction& action = recorded[k];
+        if (action.tick > settings->ticks || (k > 0 && action.tick < recorded[k - 1].tick)) return false;
+        if (action.kind < PlayerActionKind::ConnectStation || action.kind > PlayerActionKind::Restart) return false;
+
+        bool atCell = action.kind == PlayerActionKind::PlaceTrain || action.kind == PlayerActionKind::EraseRails;
+        if (atCell && (action.i < 0 || action.i >= height || action.j < 0 || action.j >= width))
+            return false;
+    }
+
+    SimConfig loaded;
+    loaded.seed = settings->seed;
+    loaded.gridWidth = settings->gridWidth;
+    loaded.gridHeight = settings->gridHeight;
+    loaded.sandbox = settings->sandbox != 0;
+    loaded.pathCosts.grass = settings->grassCost;
+    loaded.pathCosts.water = settings->waterCost;
+    loaded.pathCosts.mountain = settings->mountainCost;
+    loaded.pathCosts.rail = settings->railCost;
+    loaded.pathCosts.heuristicWeight = settings->heuristicWeight;
+    loaded.terrain.heightmapPath.assign(heightmap, heightmapLength);
+    loaded.terrain.heightmapWeight = settings->heightmapWeight;
+    loaded.terrain.featureSize = settings->featureSize;
+    loaded.terrain.octaves = settings->octaves;
+    loaded.terrain.waterLevel = settings->waterLevel;
+    loaded.terrain.mountainLevel = settings->mountainLevel;
+    loaded.terrain.riverWidth = settings->riverWidth;
+    loaded.terrain.smoothingPasses = settings->smoothingPasses;
+
+    config = loaded;
+    dt = settings->dt;
+    ticks = settings->ticks;
+    actions.assign(recorded, recorded + actionCount);
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "lab_m1/tema2/sim/sim_types.h"
+#include "lab_m1/tema2/sim/train_sim.h"
+
+
+namespace m1
+{
+    // Recording of one game: the settings it was started with, the fixed
+    // step it was ticked at and every player action, stamped with the tick
+    // it came before. A new TrainSim started from Config() and fed the same
+    // actions at the same ticks plays the same game, which TrainSimCli
+    // --replay does as fast as it can.
+    class ActionLog
+    {
+    public:
+        ActionLog();
+
+        // Starts over for a game just started with config
+        void Begin(const SimConfig& config, float dt);
+
+        void Record(const PlayerAction& action);
+        void Tick() { ticks++; }
+
+        // Settings of the recorded game; the thread count is left at the
+        // default, it does not change the result
+        SimConfig Config() const { return config; }
+        float Dt() const { return dt; }
+        uint64_t Ticks() const { return ticks; }
+        const std::vector<PlayerAction>& Actions() const { return actions; }
+
+        // Stored with the snapshot container, see snapshot.h. Load leaves
+        // the log as it was when the file is not a valid recording.
+        bool Save(const std::string& path) const;
+        bool Load(const std::string& path);
+
+    private:
+        SimConfig config;
+        float dt;
+        uint64_t ticks;
+        std::vector<PlayerAction> actions;
+    };
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+
+namespace m1
+{
+    // One bit per map cell, a row at a time in 64-bit words: bit b of word k
+    // in row i is cell (i, k * 64 + b). Bits past the map width stay zero.
+    // One plane per terrain class lets whole-map passes work on 64 cells
+    // per instruction.
+    class BitPlane
+    {
+    public:
+        static constexpr int WORD_BITS = 64;
+
+        BitPlane() : width(0), height(0), wordsPerRow(0) {}
+
+        void Assign(int w, int h)
+        {
+            width = w;
+            height = h;
+            wordsPerRow = (w + WORD_BITS - 1) / WORD_BITS;
+            words.assign((size_t)wordsPerRow * h, 0);
+        }
+
+        int Width() const { return width; }
+        int Height() const { return height; }
+        int WordsPerRow() const { return wordsPerRow; }
+
+        uint64_t* Row(int i) { return &words[(size_t)i * wordsPerRow]; }
+        const uint64_t* Row(int i) const { return &words[(size_t)i * wordsPerRow]; }
+
+        // All rows back to back
+        uint64_t* Data() { return words.data(); }
+        const uint64_t* Data() const { return words.data(); }
+
+        bool Get(int i, int j) const
+        {
+            return (Row(i)[j / WORD_BITS] >> (j % WORD_BITS)) & 1;
+        }
+
+        void Swap(BitPlane& other)
+        {
+            std::swap(width, other.width);
+            std::swap(height, other.height);
+            std::swap(wordsPerRow, other.wordsPerRow);
+            words.swap(other.words);
+        }
+
+    private:
+        int width, height;
+        int wordsPerRow;
+        std::vector<uint64_t> words;
+    };
+
+    // Index of the lowest set bit; bits must not be zero
+    inline int LowestBit(uint64_t bits)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return (int)index;
+#else
+        return __builtin_ctzll(bits);
+#endif
+    }
+
+    inline int PopCount(uint64_t bits)
+    {
+#if defined(_MSC_VER)
+        return (int)__popcnt64(bits);
+#else
+        return __builtin_popcountll(bits);
+#endif
+    }
+}
@@ -0,0 +1,82 @@
+#include "lab_m1/tema2/sim/block_signals.h"
+
+using namespace std;
+using namespace m1;
+
+
+// Claims and entries are separate passes of the train update, and the pool
+// synchronizes between passes, so relaxed accesses are enough: they only
+// have to be atomic against the other trains of the same pass.
+
+BlockSignals::BlockSignals()
+{
+    chunksX = 0;
+}
+
+void BlockSignals::Reset(int width, int height)
+{
+    chunksX = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    int chunksY = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    chunks.clear();
+    chunks.resize((size_t)chunksX * chunksY);
+}
+
+void BlockSignals::Reserve(int i, int j)
+{
+    std::unique_ptr<Entry[]>& chunk = chunks[ChunkIndex(i, j)];
+    if (chunk) return;
+
+    chunk.reset(new Entry[CHUNK_SIZE * CHUNK_SIZE]);
+    for (int k = 0; k < CHUNK_SIZE * CHUNK_SIZE; k++)
+        chunk[k].store(0, std::memory_order_relaxed);
+}
+
+BlockSignals::Entry& BlockSignals::At(int i, int j) const
+{
+    const std::unique_ptr<Entry[]>& chunk = chunks[ChunkIndex(i, j)];
+    return chunk[(i % CHUNK_SIZE) * CHUNK_SIZE + j % CHUNK_SIZE];
+}
+
+int BlockSignals::Holder(int i, int j) const
+{
+    if (!chunks[ChunkIndex(i, j)]) return -1;
+
+    uint32_t entry = At(i, j).load(std::memory_order_relaxed);
+    if (entry == 0 || (entry & CLAIMED)) return -1;
+    return (int)(entry - 1);
+}
+
+bool BlockSignals::Hold(int i, int j, uint32_t slot)
+{
+    uint32_t expected = 0;
+    return At(i, j).compare_exchange_strong(expected, slot + 1, std::memory_order_relaxed);
+}
+
+void BlockSignals::Release(int i, int j)
+{
+    if (!chunks[ChunkIndex(i, j)]) return;
+    At(i, j).store(0, std::memory_order_relaxed);
+}
+
+void BlockSignals::Claim(int i, int j, uint32_t slot)
+{
+    Entry& entry = At(i, j);
+    uint32_t claim = CLAIMED | (slot + 1);
+
+    // Only free cells and higher claims give way
+    uint32_t current = entry.load(std::memory_order_relaxed);
+    while (current == 0 || ((current & CLAIMED) && current > claim)) {
+        if (entry.compare_exchange_weak(current, claim, std::memory_order_relaxed))
+            return;
+    }
+}
+
+bool BlockSignals::Enter(int i, int j, uint32_t slot)
+{
+    Entry& entry = At(i, j);
+    if (entry.load(std::memory_order_relaxed) != (CLAIMED | (slot + 1))) return false;
+
+    entry.store(slot + 1, std::memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "lab_m1/tema2/sim/chunked_grid.h"
+#include "lab_m1/tema2/sim/sim_types.h"
+
+
+namespace m1
+{
+    // Block signalling with one block per rail cell: a cell is held by at
+    // most one train, named by its handle slot. Entering a cell is two
+    // steps, so it can run from the parallel train update and still give
+    // the same result for any thread count:
+    //
+    //  - Claim, during the parallel pass, marks a free cell with a claim
+    //    by compare-and-swap. Of several trains claiming one cell in the
+    //    same tick the lowest slot is left, whatever order they came in.
+    //    Held cells cannot be claimed.
+    //  - Enter, after every claim is in, turns the train's own claim into
+    //    a hold and fails for every other claimant.
+    //
+    // Entries are per chunk of the cell grid and only allocated for chunks
+    // that ever had rail, so large maps pay for the track they have.
+    class BlockSignals
+    {
+    public:
+        BlockSignals();
+
+        void Reset(int width, int height);
+
+        // Allocates the chunk holding (i, j). Not thread safe; every cell
+        // a train can reach must be reserved before the update runs.
+        void Reserve(int i, int j);
+
+        // Slot of the train holding the cell, -1 when there is none
+        int Holder(int i, int j) const;
+
+        // For serial callers: takes a free cell outright
+        bool Hold(int i, int j, uint32_t slot);
+        void Release(int i, int j);
+
+        // ===== TWO-STEP ENTRY =====
+        // A claim can still be taken over by a lower slot; only Enter decides
+        void Claim(int i, int j, uint32_t slot);
+        bool Enter(int i, int j, uint32_t slot);
+
+    private:
+        static constexpr uint32_t CLAIMED = 0x80000000u;
+        static constexpr int CHUNK_SIZE = ChunkedGrid<Cell>::CHUNK_SIZE;
+
+        typedef std::atomic<uint32_t> Entry;
+
+        // 0 for a free cell, else the slot plus one, with CLAIMED set
+        // while it is only claimed
+        Entry& At(int i, int j) const;
+
+        size_t ChunkIndex(int i, int j) const
+        {
+            return (size_t)(i / CHUNK_SIZE) * chunksX + j / CHUNK_SIZE;
+        }
+
+        std::vector<std::unique_ptr<Entry[]>> chunks;
+        int chunksX;
+    };
+}
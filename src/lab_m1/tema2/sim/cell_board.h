@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "lab_m1/tema2/sim/chunked_grid.h"
+#include "lab_m1/tema2/sim/sim_types.h"
+
+
+namespace m1
+{
+    // Bitboard queries over packed cells. A board covers the 64 cells of one
+    // row inside a chunk: bit b is cell (i, j0 + b), where j0 is the first
+    // column of the chunk, so boards line up with BitPlane words. A cell
+    // matches when (cell.bits & mask) == value.
+    //
+    // Dense rows are read eight cells per 64-bit load and compared bytewise
+    // without branches; byte k of a load is cell k, which assumes a
+    // little-endian target. Uniform chunks answer for the whole row at once.
+
+    // Bits of the cells that exist in a row of count cells
+    inline uint64_t RowBits(int count)
+    {
+        return count >= 64 ? ~0ULL : (1ULL << count) - 1;
+    }
+
+    inline uint64_t MatchCells(const Cell* cells, int count, unsigned char mask, unsigned char value)
+    {
+        const uint64_t BYTES = 0x0101010101010101ULL;
+        const uint64_t LOW_BITS = 0x7F7F7F7F7F7F7F7FULL;
+        // Moves bit 8k of a word to bit 56 + k
+        const uint64_t GATHER = 0x0102040810204080ULL;
+
+        uint64_t board = 0;
+        int k = 0;
+        for (; k + 8 <= count; k += 8) {
+            uint64_t word;
+            std::memcpy(&word, cells + k, sizeof(word));
+
+            // Zero bytes of x are the matching cells; the top bit of each
+            // byte of nonZero is set unless the byte is zero
+            uint64_t x = (word & (mask * BYTES)) ^ (value * BYTES);
+            uint64_t nonZero = ((x & LOW_BITS) + LOW_BITS) | x;
+            uint64_t zero = (~nonZero & ~LOW_BITS) >> 7;
+            board |= ((zero * GATHER) >> 56) << k;
+        }
+        for (; k < count; k++)
+            if ((cells[k].bits & mask) == value) board |= 1ULL << k;
+
+        return board;
+    }
+
+    inline uint64_t MatchChunkRow(const ChunkedGrid<Cell>& grid, int i, int chunkCol,
+        unsigned char mask, unsigned char value)
+    {
+        static_assert(ChunkedGrid<Cell>::CHUNK_SIZE == 64, "a chunk row must fit one board");
+
+        int chunkRow = grid.ChunkRowOf(i);
+        int i0, j0, i1, j1;
+        grid.ChunkCellRange(chunkRow, chunkCol, i0, j0, i1, j1);
+
+        const ChunkedGrid<Cell>::Chunk& chunk = grid.GetChunk(chunkRow, chunkCol);
+        if (chunk.IsUniform())
+            return (chunk.uniform.bits & mask) == value ? RowBits(j1 - j0) : 0;
+
+        const Cell* row = &chunk.cells[(size_t)(i - i0) * ChunkedGrid<Cell>::CHUNK_SIZE];
+        return MatchCells(row, j1 - j0, mask, value);
+    }
+
+    // ===== QUERIES =====
+    inline uint64_t RailCells(const ChunkedGrid<Cell>& grid, int i, int chunkCol)
+    {
+        int i0, j0, i1, j1;
+        grid.ChunkCellRange(grid.ChunkRowOf(i), chunkCol, i0, j0, i1, j1);
+        return ~MatchChunkRow(grid, i, chunkCol, CELL_RAIL_MASK, 0) & RowBits(j1 - j0);
+    }
+
+    inline uint64_t TerrainCells(const ChunkedGrid<Cell>& grid, int i, int chunkCol, CellType type)
+    {
+        return MatchChunkRow(grid, i, chunkCol, CELL_TYPE_MASK, (unsigned char)type);
+    }
+
+    // Grass without a station, the terrain side of a valid station cell
+    inline uint64_t FreeLandCells(const ChunkedGrid<Cell>& grid, int i, int chunkCol)
+    {
+        return MatchChunkRow(grid, i, chunkCol, CELL_TYPE_MASK | CELL_STATION, 0);
+    }
+}
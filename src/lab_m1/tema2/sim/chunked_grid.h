@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+
+namespace m1
+{
+    // Sparse 2D storage split into square chunks of CHUNK_SIZE x CHUNK_SIZE
+    // cells. A chunk whose cells all hold the same value is stored as that one
+    // value; it is only expanded to a full array when one of its cells is
+    // edited to something else. Compact() collapses chunks back once they
+    // become uniform again.
+    //
+    // Reads go through At(), writes through Edit() or Set(). Edit() always
+    // expands the chunk, Set() only does so when the value actually changes.
+    template <typename T, int CHUNK_SHIFT = 6>
+    class ChunkedGrid
+    {
+    public:
+        static constexpr int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+        static constexpr int CHUNK_MASK = CHUNK_SIZE - 1;
+        static constexpr int CHUNK_CELLS = CHUNK_SIZE * CHUNK_SIZE;
+
+        struct Chunk
+        {
+            T uniform;
+            std::vector<T> cells;   // empty while the chunk is uniform
+
+            bool IsUniform() const { return cells.empty(); }
+        };
+
+        ChunkedGrid() : width(0), height(0), chunksX(0), chunksY(0) {}
+
+        void Assign(int w, int h, const T& value = T())
+        {
+            width = w;
+            height = h;
+            chunksX = (w + CHUNK_MASK) >> CHUNK_SHIFT;
+            chunksY = (h + CHUNK_MASK) >> CHUNK_SHIFT;
+
+            Chunk chunk;
+            chunk.uniform = value;
+            chunks.assign((size_t)chunksX * chunksY, chunk);
+        }
+
+        void Clear()
+        {
+            width = height = chunksX = chunksY = 0;
+            chunks.clear();
+        }
+
+        int Width() const { return width; }
+        int Height() const { return height; }
+        bool Empty() const { return chunks.empty(); }
+
+        bool InBounds(int i, int j) const
+        {
+            return i >= 0 && j >= 0 && i < height && j < width;
+        }
+
+        const T& At(int i, int j) const
+        {
+            const Chunk& chunk = ChunkOf(i, j);
+            if (chunk.IsUniform()) return chunk.uniform;
+            return chunk.cells[LocalIndex(i, j)];
+        }
+
+        T& Edit(int i, int j)
+        {
+            Chunk& chunk = ChunkOf(i, j);
+            if (chunk.IsUniform()) chunk.cells.assign(CHUNK_CELLS, chunk.uniform);
+            return chunk.cells[LocalIndex(i, j)];
+        }
+
+        void Set(int i, int j, const T& value)
+        {
+            if (At(i, j) == value) return;
+            Edit(i, j) = value;
+        }
+
+        // ===== CHUNK ACCESS =====
+        int ChunksX() const { return chunksX; }
+        int ChunksY() const { return chunksY; }
+        int ChunkRowOf(int i) const { return i >> CHUNK_SHIFT; }
+        int ChunkColOf(int j) const { return j >> CHUNK_SHIFT; }
+
+        const Chunk& GetChunk(int chunkRow, int chunkCol) const
+        {
+            return chunks[(size_t)chunkRow * chunksX + chunkCol];
+        }
+
+        // For bulk loads; a chunk with cells must have CHUNK_CELLS of them
+        Chunk& EditChunk(int chunkRow, int chunkCol)
+        {
+            return chunks[(size_t)chunkRow * chunksX + chunkCol];
+        }
+
+        // Cell range [i0, i1) x [j0, j1) covered by a chunk, clipped to the map
+        void ChunkCellRange(int chunkRow, int chunkCol, int& i0, int& j0, int& i1, int& j1) const
+        {
+            i0 = chunkRow << CHUNK_SHIFT;
+            j0 = chunkCol << CHUNK_SHIFT;
+            i1 = std::min(i0 + CHUNK_SIZE, height);
+            j1 = std::min(j0 + CHUNK_SIZE, width);
+        }
+
+        // Collapses the chunk back to a single value if all its cells match
+        bool CompactChunk(int chunkRow, int chunkCol)
+        {
+            Chunk& chunk = chunks[(size_t)chunkRow * chunksX + chunkCol];
+            if (chunk.IsUniform()) return true;
+
+            const T& first = chunk.cells[0];
+            for (int k = 1; k < CHUNK_CELLS; k++)
+                if (!(chunk.cells[k] == first)) return false;
+
+            chunk.uniform = first;
+            std::vector<T>().swap(chunk.cells);
+            return true;
+        }
+
+        void Compact()
+        {
+            for (int r = 0; r < chunksY; r++)
+                for (int c = 0; c < chunksX; c++)
+                    CompactChunk(r, c);
+        }
+
+        int AllocatedChunks() const
+        {
+            int count = 0;
+            for (const Chunk& chunk : chunks)
+                if (!chunk.IsUniform()) count++;
+            return count;
+        }
+
+        size_t MemoryBytes() const
+        {
+            return chunks.size() * sizeof(Chunk) + (size_t)AllocatedChunks() * CHUNK_CELLS * sizeof(T);
+        }
+
+    private:
+        const Chunk& ChunkOf(int i, int j) const
+        {
+            return chunks[(size_t)(i >> CHUNK_SHIFT) * chunksX + (j >> CHUNK_SHIFT)];
+        }
+
+        Chunk& ChunkOf(int i, int j)
+        {
+            return chunks[(size_t)(i >> CHUNK_SHIFT) * chunksX + (j >> CHUNK_SHIFT)];
+        }
+
+        static int LocalIndex(int i, int j)
+        {
+            return ((i & CHUNK_MASK) << CHUNK_SHIFT) | (j & CHUNK_MASK);
+        }
+
+        int width, height;
+        int chunksX, chunksY;
+        std::vector<Chunk> chunks;
+    };
+}
@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "lab_m1/tema2/sim/action_log.h"
+#include "lab_m1/tema2/sim/train_sim.h"
+
+using namespace m1;
+
+
+struct RunnerOptions
+{
+    long long ticks = 100000;
+    float dt = 1.0f / 60.0f;
+    unsigned int seed = 1;
+    bool autoplay = false;
+    bool sandbox = false;
+    int wagons = 3;
+    int trainsPerLine = 1;
+    int threads = 1;
+    int width = 16;
+    int height = 16;
+    int pathQueries = 0;
+    int pathWeight = 100;
+    std::string heightmap;
+    std::string loadPath;
+    std::string savePath;
+    std::string recordPath;
+    std::string replayPath;
+    long long hashEvery = 0;
+};
+
+
+static void PrintUsage(const char* self)
+{
+    printf("Usage: %s [options]\n", self);
+    printf("  --ticks N      number of simulation ticks to run (default 100000)\n");
+    printf("  --dt SECONDS   simulated seconds per tick (default 1/60)\n");
+    printf("  --seed N       random seed (default 1)\n");
+    printf("  --width N      map width in cells (default 16)\n");
+    printf("  --height N     map height in cells (default 16)\n");
+    printf("  --autoplay     connect every new station to the previous one and put a train on it\n");
+    printf("  --wagons N     wagons per autoplay train (default 3)\n");
+    printf("  --trains N     autoplay trains per new line (default 1)\n");
+    printf("  --threads N    threads for the train update, 0 = all cores (default 1)\n");
+    printf("  --sandbox      actions are free and full stations never end the game\n");
+    printf("  --heightmap F  blend a grayscale image into the terrain noise\n");
+    printf("  --path-bench N time N random point-to-point path queries after the run\n");
+    printf("  --path-weight P  A* heuristic weight in percent (default 100)\n");
+    printf("  --load FILE    start from a saved snapshot instead of a new map\n");
+    printf("  --save FILE    write a snapshot of the game after the run\n");
+    printf("  --record FILE  write every action of the run to a replay file\n");
+    printf("  --replay FILE  replay a recorded game; map, seed and tick options come from the file\n");
+    printf("  --hash-every N print the state hash every N ticks\n");
+}
+
+
+static bool ParseOptions(int argc, char** argv, RunnerOptions& opts)
+{
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        bool hasValue = k + 1 < argc;
+
+        if (arg == "--ticks" && hasValue) opts.ticks = std::atoll(argv[++k]);
+        else if (arg == "--dt" && hasValue) opts.dt = (float)std::atof(argv[++k]);
+        else if (arg == "--seed" && hasValue) opts.seed = (unsigned int)std::strtoul(argv[++k], nullptr, 10);
+        else if (arg == "--width" && hasValue) opts.width = std::atoi(argv[++k]);
+        else if (arg == "--height" && hasValue) opts.height = std::atoi(argv[++k]);
+        else if (arg == "--wagons" && hasValue) opts.wagons = std::atoi(argv[++k]);
+        else if (arg == "--trains" && hasValue) opts.trainsPerLine = std::atoi(argv[++k]);
+        else if (arg == "--threads" && hasValue) opts.threads = std::atoi(argv[++k]);
+        else if (arg == "--path-bench" && hasValue) opts.pathQueries = std::atoi(argv[++k]);
+        else if (arg == "--path-weight" && hasValue) opts.pathWeight = std::atoi(argv[++k]);
+        else if (arg == "--heightmap" && hasValue) opts.heightmap = argv[++k];
+        else if (arg == "--load" && hasValue) opts.loadPath = argv[++k];
+        else if (arg == "--save" && hasValue) opts.savePath = argv[++k];
+        else if (arg == "--record" && hasValue) opts.recordPath = argv[++k];
+        else if (arg == "--replay" && hasValue) opts.replayPath = argv[++k];
+        else if (arg == "--hash-every" && hasValue) opts.hashEvery = std::atoll(argv[++k]);
+        else if (arg == "--autoplay") opts.autoplay = true;
+        else if (arg == "--sandbox") opts.sandbox = true;
+        else return false;
+    }
+    // Recordings start from a new map and replays bring their own
+    bool replay = !opts.replayPath.empty();
+    if ((replay || !opts.recordPath.empty()) && !opts.loadPath.empty()) return false;
+    if (replay && (opts.autoplay || !opts.recordPath.empty())) return false;
+
+    return opts.ticks > 0 && opts.dt > 0.0f;
+}
+
+
+// Player actions of the runner go through here, so --record captures them
+static TrainHandle Act(TrainSim& sim, ActionLog* log, const PlayerAction& action)
+{
+    if (log) log->Record(action);
+    return sim.Perform(action);
+}
+
+
+// Simple bot used for load tests: every station that appears gets linked to
+// the previous one, and trains are placed on the new line near its start.
+static void Autoplay(TrainSim& sim, ActionLog* log, int& linkedStations, int wagons, int trainsPerLine)
+{
+    const auto& stations = sim.GetStations();
+    if (linkedStations == 0 && !stations.Empty()) linkedStations = 1;
+
+    while (linkedStations < stations.Count()) {
+        const glm::vec3& from = stations.pos[linkedStations - 1];
+        const glm::vec3& to = stations.pos[linkedStations];
+
+        Act(sim, log, PlayerAction::ConnectStation(from));
+        Act(sim, log, PlayerAction::ConnectStation(to));
+
+        int i, j;
+        if (sim.WorldToCell(from, i, j)) {
+            TrainHandle train = Act(sim, log, PlayerAction::AtCell(PlayerActionKind::PlaceTrain, i, j));
+            for (int w = 1; w < wagons; w++)
+                Act(sim, log, PlayerAction::AddWagon(train.slot, train.generation));
+
+            // Extra trains go on the nearest free track around the station
+            int placed = 1;
+            for (int r = 1; r <= 8 && placed < trainsPerLine; r++) {
+                for (int ni = i - r; ni <= i + r && placed < trainsPerLine; ni++) {
+                    for (int nj = j - r; nj <= j + r && placed < trainsPerLine; nj++) {
+                        if (std::max(std::abs(ni - i), std::abs(nj - j)) != r) continue;
+                        if (!sim.GetGrid().InBounds(ni, nj)) continue;
+
+                        train = Act(sim, log, PlayerAction::AtCell(PlayerActionKind::PlaceTrain, ni, nj));
+                        if (sim.GetTrains().Find(train) < 0) continue;
+
+                        for (int w = 1; w < wagons; w++)
+                            Act(sim, log, PlayerAction::AddWagon(train.slot, train.generation));
+                        placed++;
+                    }
+                }
+            }
+        }
+
+        linkedStations++;
+    }
+}
+
+
+template<typename Finder>
+static void RunPathQueries(const char* label, Finder& finder, const ChunkedGrid<Cell>& grid,
+    const std::vector<int>& endpoints)
+{
+    std::vector<std::pair<int, int>> path;
+    long long totalLength = 0;
+    long long totalCost = 0;
+    int queries = (int)endpoints.size() / 4;
+    int found = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; q++) {
+        const int* e = &endpoints[q * 4];
+        if (finder.FindPath(grid, e[0], e[1], e[2], e[3], path)) {
+            found++;
+            totalLength += path.size();
+            for (size_t k = 1; k < path.size(); k++)
+                totalCost += finder.GetCosts().For(grid.At(path[k].first, path[k].second));
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double micros = std::chrono::duration<double, std::micro>(end - start).count();
+    printf("%-6s queries:  %d (%d found)\n", label, queries, found);
+    printf("%-6s avg time: %.1f us\n", label, micros / queries);
+    printf("%-6s avg len:  %.0f cells, cost %.0f\n", label,
+        found ? (double)totalLength / found : 0.0, found ? (double)totalCost / found : 0.0);
+}
+
+struct FlatFinder
+{
+    Pathfinder pathfinder;
+
+    bool FindPath(const ChunkedGrid<Cell>& grid, int si, int sj, int ti, int tj,
+        std::vector<std::pair<int, int>>& outPath)
+    {
+        return pathfinder.FindPath(grid, si, sj, ti, tj, outPath);
+    }
+
+    const PathCosts& GetCosts() const { return pathfinder.costs; }
+};
+
+static void PathBench(const TrainSim& sim, int queries, int weight, unsigned int seed)
+{
+    const ChunkedGrid<Cell>& grid = sim.GetGrid();
+
+    Random random(seed, 0);
+    std::vector<int> endpoints;
+    for (int q = 0; q < queries; q++) {
+        endpoints.push_back(random.Below(grid.Height()));
+        endpoints.push_back(random.Below(grid.Width()));
+        endpoints.push_back(random.Below(grid.Height()));
+        endpoints.push_back(random.Below(grid.Width()));
+    }
+
+    PathCosts costs;
+    costs.heuristicWeight = weight;
+
+    FlatFinder flat;
+    flat.pathfinder.costs = costs;
+    RunPathQueries("flat", flat, grid, endpoints);
+
+    // The first pass builds clusters on demand, the second reuses them
+    HierarchicalPathfinder hierarchical;
+    hierarchical.SetCosts(costs);
+    hierarchical.Reset(grid.Width(), grid.Height());
+    RunPathQueries("hpa", hierarchical, grid, endpoints);
+    printf("hpa    clusters: %d built\n", hierarchical.BuiltClusters());
+    RunPathQueries("hpa", hierarchical, grid, endpoints);
+}
+
+
+int main(int argc, char** argv)
+{
+    RunnerOptions opts;
+    if (!ParseOptions(argc, argv, opts)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    SimConfig config;
+    config.sandbox = opts.sandbox;
+    config.gridWidth = opts.width;
+    config.gridHeight = opts.height;
+    config.pathCosts.heuristicWeight = opts.pathWeight;
+    config.threads = opts.threads;
+    config.seed = opts.seed;
+    config.terrain.heightmapPath = opts.heightmap;
+
+    ActionLog log;
+    bool replay = !opts.replayPath.empty();
+    if (replay) {
+        if (!log.Load(opts.replayPath)) {
+            fprintf(stderr, "could not load replay %s\n", opts.replayPath.c_str());
+            return 1;
+        }
+        config = log.Config();
+        config.threads = opts.threads;
+        opts.dt = log.Dt();
+        opts.ticks = (long long)log.Ticks();
+    }
+
+    bool recording = !opts.recordPath.empty();
+    if (recording) log.Begin(config, opts.dt);
+
+    TrainSim sim;
+    auto initStart = std::chrono::steady_clock::now();
+    sim.Init(config);
+    if (!opts.loadPath.empty() && !sim.LoadSnapshot(opts.loadPath)) {
+        fprintf(stderr, "could not load snapshot %s\n", opts.loadPath.c_str());
+        return 1;
+    }
+    double initSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - initStart).count();
+
+    if (!opts.heightmap.empty() && !sim.UsesHeightmap())
+        fprintf(stderr, "could not read heightmap %s, using noise only\n", opts.heightmap.c_str());
+
+    // A loaded game counts as linked up, as it is when autoplay saved it
+    int linkedStations = opts.loadPath.empty() ? 0 : sim.GetStations().Count();
+    int restarts = 0;
+    size_t nextAction = 0;
+
+    // Actions of a tick all come before it, in recording and replay alike,
+    // so the hashes of both line up
+    auto start = std::chrono::steady_clock::now();
+    for (long long tick = 0; tick < opts.ticks; tick++) {
+        if (replay) {
+            const std::vector<PlayerAction>& actions = log.Actions();
+            for (; nextAction < actions.size() && actions[nextAction].tick == (uint64_t)tick; nextAction++) {
+                if (actions[nextAction].kind == PlayerActionKind::Restart) restarts++;
+                sim.Perform(actions[nextAction]);
+            }
+        }
+        else {
+            if (sim.IsGameOver()) {
+                Act(sim, recording ? &log : nullptr, PlayerAction::Restart());
+                linkedStations = 0;
+                restarts++;
+            }
+            if (opts.autoplay)
+                Autoplay(sim, recording ? &log : nullptr, linkedStations, opts.wagons, opts.trainsPerLine);
+        }
+
+        sim.Tick(opts.dt);
+        if (recording) log.Tick();
+
+        if (opts.hashEvery > 0 && (tick + 1) % opts.hashEvery == 0)
+            printf("tick %-9lld hash %016llx\n", tick + 1, (unsigned long long)sim.StateHash());
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    if (recording && !log.Save(opts.recordPath))
+        fprintf(stderr, "could not save replay %s\n", opts.recordPath.c_str());
+
+    if (!opts.savePath.empty() && !sim.SaveSnapshot(opts.savePath))
+        fprintf(stderr, "could not save snapshot %s\n", opts.savePath.c_str());
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double ticksPerSecond = seconds > 0.0 ? opts.ticks / seconds : 0.0;
+
+    printf("map:            %dx%d\n", sim.GridWidth(), sim.GridHeight());
+    printf("ticks:          %lld\n", opts.ticks);
+    printf("init time:      %.3f s\n", initSeconds);
+    printf("wall time:      %.3f s\n", seconds);
+    printf("ticks/second:   %.0f\n", ticksPerSecond);
+    printf("sim time:       %.1f s\n", sim.GetGameTime());
+    printf("stations:       %d\n", sim.GetStations().Count());
+    printf("trains:         %d\n", (int)sim.GetTrains().Count());
+    printf("delivered:      %d\n", sim.GetDeliveredPassengers());
+    printf("points:         %d\n", sim.GetPoints());
+    printf("restarts:       %d\n", restarts);
+    printf("state hash:     %016llx\n", (unsigned long long)sim.StateHash());
+    printf("grid chunks:    %d of %d allocated, %.1f MiB\n",
+        sim.GetGrid().AllocatedChunks(), sim.GetGrid().ChunksX() * sim.GetGrid().ChunksY(),
+        sim.GetGrid().MemoryBytes() / (1024.0 * 1024.0));
+    printf("rail network:   %d nodes, %d edges, %d components\n",
+        sim.GetRailNetwork().NodeCount(), sim.GetRailNetwork().EdgeCount(),
+        sim.GetRailNetwork().ComponentCount());
+
+    if (opts.pathQueries > 0) PathBench(sim, opts.pathQueries, opts.pathWeight, opts.seed);
+
+    return 0;
+}
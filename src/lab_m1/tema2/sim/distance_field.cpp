@@ -0,0 +1,209 @@
+#include "lab_m1/tema2/sim/distance_field.h"
+
+#include <algorithm>
+#include <climits>
+
+using namespace std;
+using namespace m1;
+
+
+namespace
+{
+    typedef std::greater<std::pair<int, int>> MinFirst;
+}
+
+
+DistanceField::DistanceField()
+{
+    markStamp = 0;
+}
+
+void DistanceField::Clear()
+{
+    distance.clear();
+    heap.clear();
+    mark.clear();
+    markStamp = 0;
+}
+
+void DistanceField::Build(const RailNetwork& network, const SourceTest& isSource)
+{
+    distance.clear();
+    Fit(network);
+
+    heap.clear();
+    for (int node = 0; node < network.NodeSlots(); node++) {
+        Reset(network, node);
+        if (network.GetNode(node).alive && isSource(node)) {
+            distance[node].distance = 0;
+            heap.push_back({ 0, node });
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), MinFirst());
+    Relax(network);
+}
+
+void DistanceField::Repair(const RailNetwork& network, const SourceTest& isSource)
+{
+    if (distance.empty()) return;
+    Fit(network);
+
+    // Nodes whose route to a source was cut, and then everything that was
+    // routed through them
+    markStamp++;
+    lost.clear();
+    for (int node : network.ChangedNodes()) {
+        if (mark[node] == markStamp) continue;
+        mark[node] = markStamp;
+        if (!Intact(network, node)) lost.push_back(node);
+    }
+    for (size_t k = 0; k < lost.size(); k++) {
+        int node = lost[k];
+        if (!network.GetNode(node).alive) continue;
+
+        for (int d = 0; d < 4; d++) {
+            int next = network.Neighbour(node, d);
+            if (next < 0 || distance[next].parent != node) continue;
+            if (mark[next] == markStamp && !Intact(network, next)) continue;
+
+            mark[next] = markStamp;
+            distance[next].parent = -1;     // no longer intact
+            distance[next].edge = -2;
+            lost.push_back(next);
+        }
+    }
+
+    // Settle the lost nodes from their intact neighbours, and let the ends
+    // of new edges pass shorter routes on
+    heap.clear();
+    for (int node : lost) Reset(network, node);
+    for (int node : lost) {
+        if (!network.GetNode(node).alive) continue;
+
+        if (isSource(node)) {
+            distance[node].distance = 0;
+            heap.push_back({ 0, node });
+            continue;
+        }
+
+        Entry& entry = distance[node];
+        for (int d = 0; d < 4; d++) {
+            int next = network.Neighbour(node, d);
+            if (next < 0 || distance[next].distance == INT_MAX) continue;
+
+            int edge = network.GetNode(node).exits[d] >> 1;
+            int candidate = distance[next].distance + network.GetEdge(edge).Length();
+            if (candidate >= entry.distance) continue;
+
+            entry.distance = candidate;
+            entry.parent = next;
+            entry.edge = edge;
+            entry.edgeVersion = network.GetEdge(edge).version;
+        }
+        if (entry.distance != INT_MAX) heap.push_back({ entry.distance, node });
+    }
+    for (int node : network.ChangedNodes()) {
+        if (!network.GetNode(node).alive) continue;
+
+        // A new source among nodes that kept their edges
+        if (distance[node].distance != 0 && isSource(node)) {
+            distance[node].distance = 0;
+            distance[node].parent = -1;
+            distance[node].edge = -1;
+        }
+        if (distance[node].distance != INT_MAX) heap.push_back({ distance[node].distance, node });
+    }
+
+    std::make_heap(heap.begin(), heap.end(), MinFirst());
+    Relax(network);
+}
+
+int DistanceField::Distance(int node) const
+{
+    if (node < 0 || node >= (int)distance.size()) return -1;
+    return distance[node].distance == INT_MAX ? -1 : distance[node].distance;
+}
+
+int DistanceField::NextExit(const RailNetwork& network, int node, int excludedDir) const
+{
+    if (node < 0 || node >= (int)distance.size() || distance[node].distance <= 0) return -1;
+
+    int best = -1;
+    int bestDistance = INT_MAX;
+    for (int d = 0; d < 4; d++) {
+        if (d == excludedDir) continue;
+
+        int next = network.Neighbour(node, d);
+        if (next < 0 || next >= (int)distance.size() || distance[next].distance == INT_MAX) continue;
+
+        int length = network.GetEdge(network.GetNode(node).exits[d] >> 1).Length();
+        if (distance[next].distance + length < bestDistance) {
+            bestDistance = distance[next].distance + length;
+            best = d;
+        }
+    }
+    return best;
+}
+
+void DistanceField::Fit(const RailNetwork& network)
+{
+    size_t slots = network.NodeSlots();
+    if (distance.size() >= slots) return;
+
+    size_t old = distance.size();
+    distance.resize(slots);
+    mark.resize(slots, 0);
+    for (size_t node = old; node < slots; node++) Reset(network, (int)node);
+}
+
+void DistanceField::Reset(const RailNetwork& network, int node)
+{
+    Entry& entry = distance[node];
+    entry.distance = INT_MAX;
+    entry.parent = -1;
+    entry.edge = -1;
+    entry.edgeVersion = 0;
+    entry.nodeVersion = network.GetNode(node).version;
+}
+
+bool DistanceField::Intact(const RailNetwork& network, int node) const
+{
+    const RailNetwork::Node& info = network.GetNode(node);
+    const Entry& entry = distance[node];
+
+    if (!info.alive || entry.nodeVersion != info.version) return false;
+    if (entry.edge == -2) return false;
+    if (entry.edge < 0) return true;
+
+    const RailNetwork::Edge& edge = network.GetEdge(entry.edge);
+    return edge.alive && edge.version == entry.edgeVersion;
+}
+
+void DistanceField::Relax(const RailNetwork& network)
+{
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), MinFirst());
+        std::pair<int, int> top = heap.back();
+        heap.pop_back();
+
+        int node = top.second;
+        if (top.first > distance[node].distance) continue;
+
+        for (int d = 0; d < 4; d++) {
+            int next = network.Neighbour(node, d);
+            if (next < 0) continue;
+
+            int edge = network.GetNode(node).exits[d] >> 1;
+            int candidate = top.first + network.GetEdge(edge).Length();
+            Entry& entry = distance[next];
+            if (candidate >= entry.distance) continue;
+
+            entry.distance = candidate;
+            entry.parent = node;
+            entry.edge = edge;
+            entry.edgeVersion = network.GetEdge(edge).version;
+            heap.push_back({ candidate, next });
+            std::push_heap(heap.begin(), heap.end(), MinFirst());
+        }
+    }
+}
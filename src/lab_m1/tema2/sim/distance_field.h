@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "lab_m1/tema2/sim/rail_network.h"
+
+
+namespace m1
+{
+    // Distance in cells from every rail network node to the nearest source
+    // node, with the edge each node's shortest route starts on. A train at a
+    // node picks its exit by looking at its (at most four) neighbours.
+    //
+    // Repair() updates the field after network edits without starting over:
+    // nodes whose route ran through a removed edge or node lose their
+    // distance, along with everything routed through them, and only those
+    // plus the ends of new edges are settled again by Dijkstra from the
+    // intact distances around them.
+    class DistanceField
+    {
+    public:
+        typedef std::function<bool(int node)> SourceTest;
+
+        DistanceField();
+
+        void Clear();
+        bool Empty() const { return distance.empty(); }
+
+        void Build(const RailNetwork& network, const SourceTest& isSource);
+        void Repair(const RailNetwork& network, const SourceTest& isSource);
+
+        // Cells to the nearest source, -1 when none is reachable
+        int Distance(int node) const;
+
+        // Exit of node that starts a shortest route to a source, never the
+        // excluded direction. -1 when there is none or node is a source.
+        int NextExit(const RailNetwork& network, int node, int excludedDir) const;
+
+    private:
+        struct Entry
+        {
+            int distance;
+            int parent;                 // next node towards the source
+            int edge;                   // edge leading there, -1 at sources
+            uint32_t edgeVersion;
+            uint32_t nodeVersion;       // of the node this entry describes
+        };
+
+        void Fit(const RailNetwork& network);
+        void Reset(const RailNetwork& network, int node);
+        void Relax(const RailNetwork& network);
+        bool Intact(const RailNetwork& network, int node) const;
+
+        std::vector<Entry> distance;
+        std::vector<std::pair<int, int>> heap;
+
+        std::vector<uint32_t> mark;
+        uint32_t markStamp;
+        std::vector<int> lost;
+    };
+}
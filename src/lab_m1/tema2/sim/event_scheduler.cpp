@@ -0,0 +1,58 @@
+#include "lab_m1/tema2/sim/event_scheduler.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace m1;
+
+
+EventScheduler::EventScheduler()
+{
+    now = 0.0;
+    nextSequence = 0;
+}
+
+void EventScheduler::Clear()
+{
+    heap.clear();
+    now = 0.0;
+    nextSequence = 0;
+}
+
+void EventScheduler::Schedule(double delay, int kind, int id, uint32_t token)
+{
+    Entry entry;
+    entry.event.time = now + delay;
+    entry.event.kind = kind;
+    entry.event.id = id;
+    entry.event.token = token;
+    entry.sequence = nextSequence++;
+
+    heap.push_back(entry);
+    std::push_heap(heap.begin(), heap.end(), Later);
+}
+
+bool EventScheduler::PopDue(Event& event)
+{
+    if (heap.empty() || heap.front().event.time > now) return false;
+
+    event = heap.front().event;
+    std::pop_heap(heap.begin(), heap.end(), Later);
+    heap.pop_back();
+    return true;
+}
+
+void EventScheduler::Restore(double savedNow, uint64_t savedNextSequence, const Entry* entries, int count)
+{
+    heap.assign(entries, entries + count);
+    std::make_heap(heap.begin(), heap.end(), Later);
+    now = savedNow;
+    nextSequence = savedNextSequence;
+}
+
+bool EventScheduler::Later(const Entry& a, const Entry& b)
+{
+    // Max-heap comparator turned around, so the earliest event is on top
+    if (a.event.time != b.event.time) return a.event.time > b.event.time;
+    return a.sequence > b.sequence;
+}
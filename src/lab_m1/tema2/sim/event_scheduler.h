@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+namespace m1
+{
+    // Deadline heap for things that happen after a delay. Nothing is polled
+    // between deadlines: each tick only pops the events that came due, in
+    // time order. Events due at the same time come out in the order they
+    // were scheduled, so runs stay reproducible.
+    //
+    // Events are never taken out early. To cancel one, the owner changes the
+    // token it was scheduled with and ignores the event when it fires.
+    class EventScheduler
+    {
+    public:
+        struct Event
+        {
+            double time;
+            int kind;
+            int id;
+            uint32_t token;
+        };
+
+        // An event with its place in the scheduling order
+        struct Entry
+        {
+            Event event;
+            uint64_t sequence;
+        };
+
+        EventScheduler();
+
+        // Drops every event and winds the clock back to zero
+        void Clear();
+
+        double Now() const { return now; }
+        int Pending() const { return (int)heap.size(); }
+
+        void Schedule(double delay, int kind, int id, uint32_t token = 0);
+
+        // Moves the clock forward; the events that came due are then taken
+        // one by one with PopDue
+        void Advance(double dt) { now += dt; }
+        bool PopDue(Event& event);
+
+        // ===== SNAPSHOTS =====
+        const std::vector<Entry>& Entries() const { return heap; }
+        uint64_t NextSequence() const { return nextSequence; }
+        void Restore(double savedNow, uint64_t savedNextSequence, const Entry* entries, int count);
+
+    private:
+        static bool Later(const Entry& a, const Entry& b);
+
+        std::vector<Entry> heap;
+        double now;
+        uint64_t nextSequence;
+    };
+}
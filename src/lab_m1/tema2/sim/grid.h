@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+
+namespace m1
+{
+    // Contiguous row-major 2D storage. Cell (i, j) is row i, column j and
+    // lives at index i * width + j, so a row is a single cache-friendly run.
+    template <typename T>
+    class Grid
+    {
+    public:
+        Grid() : width(0), height(0) {}
+        Grid(int width, int height, const T& value = T())
+        {
+            Assign(width, height, value);
+        }
+
+        void Assign(int w, int h, const T& value = T())
+        {
+            width = w;
+            height = h;
+            cells.assign((size_t)w * h, value);
+        }
+
+        void Fill(const T& value)
+        {
+            std::fill(cells.begin(), cells.end(), value);
+        }
+
+        void Clear()
+        {
+            width = height = 0;
+            cells.clear();
+        }
+
+        int Width() const { return width; }
+        int Height() const { return height; }
+        size_t Size() const { return cells.size(); }
+        bool Empty() const { return cells.empty(); }
+
+        bool InBounds(int i, int j) const
+        {
+            return i >= 0 && j >= 0 && i < height && j < width;
+        }
+
+        size_t Index(int i, int j) const { return (size_t)i * width + j; }
+        int RowOf(size_t index) const { return (int)(index / width); }
+        int ColOf(size_t index) const { return (int)(index % width); }
+
+        T& At(int i, int j) { return cells[Index(i, j)]; }
+        const T& At(int i, int j) const { return cells[Index(i, j)]; }
+
+        T& operator[](size_t index) { return cells[index]; }
+        const T& operator[](size_t index) const { return cells[index]; }
+
+        T* Row(int i) { return cells.data() + (size_t)i * width; }
+        const T* Row(int i) const { return cells.data() + (size_t)i * width; }
+
+        T* Data() { return cells.data(); }
+        const T* Data() const { return cells.data(); }
+
+    private:
+        int width, height;
+        std::vector<T> cells;
+    };
+}
@@ -0,0 +1,470 @@
+#include "lab_m1/tema2/sim/hierarchical_pathfinder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+
+using namespace std;
+using namespace m1;
+
+
+namespace
+{
+    const int DI[4] = { -1, 0, 1, 0 };
+    const int DJ[4] = { 0, 1, 0, -1 };
+}
+
+
+constexpr int HierarchicalPathfinder::CLUSTER_SIZE;
+constexpr int HierarchicalPathfinder::INF;
+
+
+HierarchicalPathfinder::HierarchicalPathfinder()
+{
+    width = height = 0;
+    clustersX = clustersY = 0;
+    horizontalBorders = 0;
+    generation = 0;
+    heuristicScale = 0;
+    pathGeneration = 0;
+    lastAbstractExpanded = 0;
+    builtClusters = 0;
+}
+
+void HierarchicalPathfinder::SetCosts(const PathCosts& pathCosts)
+{
+    flat.costs = pathCosts;
+    Reset(width, height);
+}
+
+/* =========================================================
+ *  Cluster layout and invalidation
+ * ========================================================= */
+void HierarchicalPathfinder::Reset(int w, int h)
+{
+    width = w;
+    height = h;
+    clustersX = (w + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    clustersY = (h + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    generation = 0;
+    builtClusters = 0;
+    pathMarks.clear();
+    pathGeneration = 0;
+
+    horizontalBorders = std::max(clustersY - 1, 0) * clustersX;
+    int verticalBorders = clustersY * std::max(clustersX - 1, 0);
+
+    borders.assign(horizontalBorders + verticalBorders, Border());
+    for (int b = 0; b < horizontalBorders; b++)
+        borders[b].horizontal = true;
+
+    clusters.assign((size_t)clustersX * clustersY, Cluster());
+    for (int r = 0; r < clustersY; r++) {
+        for (int c = 0; c < clustersX; c++) {
+            Cluster& cluster = clusters[r * clustersX + c];
+            cluster.i0 = r * CLUSTER_SIZE;
+            cluster.j0 = c * CLUSTER_SIZE;
+            cluster.i1 = std::min(cluster.i0 + CLUSTER_SIZE, h);
+            cluster.j1 = std::min(cluster.j0 + CLUSTER_SIZE, w);
+
+            cluster.border[0] = r > 0 ? (r - 1) * clustersX + c : -1;
+            cluster.border[1] = c < clustersX - 1 ? horizontalBorders + r * (clustersX - 1) + c : -1;
+            cluster.border[2] = r < clustersY - 1 ? r * clustersX + c : -1;
+            cluster.border[3] = c > 0 ? horizontalBorders + r * (clustersX - 1) + c - 1 : -1;
+        }
+    }
+}
+
+void HierarchicalPathfinder::InvalidateCell(int i, int j)
+{
+    if (clusters.empty()) return;
+
+    int r = i / CLUSTER_SIZE;
+    int c = j / CLUSTER_SIZE;
+    Cluster& cluster = clusters[r * clustersX + c];
+    cluster.dirty = true;
+
+    // A cell on a cluster edge also moves the transitions of that border,
+    // which changes the node list of the cluster on the other side
+    int side = -1;
+    if (i == cluster.i0) side = 0;
+    else if (i == cluster.i1 - 1) side = 2;
+    if (side >= 0 && cluster.border[side] >= 0) {
+        borders[cluster.border[side]].dirty = true;
+        clusters[(r + DI[side]) * clustersX + c].dirty = true;
+    }
+
+    side = -1;
+    if (j == cluster.j0) side = 3;
+    else if (j == cluster.j1 - 1) side = 1;
+    if (side >= 0 && cluster.border[side] >= 0) {
+        borders[cluster.border[side]].dirty = true;
+        clusters[r * clustersX + c + DJ[side]].dirty = true;
+    }
+}
+
+void HierarchicalPathfinder::EnsureBorder(const ChunkedGrid<Cell>& grid, int borderIndex)
+{
+    Border& border = borders[borderIndex];
+    if (!border.dirty) return;
+
+    border.transitions.clear();
+
+    // Walk along the border and put one transition in the middle of every
+    // run of cell pairs that cost the same to cross
+    int i, j, length;
+    if (border.horizontal) {
+        int r = borderIndex / clustersX;
+        int c = borderIndex % clustersX;
+        i = (r + 1) * CLUSTER_SIZE - 1;
+        j = c * CLUSTER_SIZE;
+        length = std::min(CLUSTER_SIZE, width - j);
+    }
+    else {
+        int index = borderIndex - horizontalBorders;
+        int r = index / (clustersX - 1);
+        int c = index % (clustersX - 1);
+        i = r * CLUSTER_SIZE;
+        j = (c + 1) * CLUSTER_SIZE - 1;
+        length = std::min(CLUSTER_SIZE, height - i);
+    }
+
+    const PathCosts& costs = flat.costs;
+    int runStart = 0;
+    int runCost = -1;
+    for (int k = 0; k <= length; k++) {
+        int cost = -1;
+        if (k < length) {
+            int ai = border.horizontal ? i : i + k;
+            int aj = border.horizontal ? j + k : j;
+            int bi = border.horizontal ? ai + 1 : ai;
+            int bj = border.horizontal ? aj : aj + 1;
+            cost = std::max(costs.For(grid.At(ai, aj)), costs.For(grid.At(bi, bj)));
+        }
+
+        if (cost == runCost) continue;
+
+        if (runCost >= 0) {
+            int mid = (runStart + k - 1) / 2;
+            Transition t;
+            t.i = border.horizontal ? i : i + mid;
+            t.j = border.horizontal ? j + mid : j;
+            border.transitions.push_back(t);
+        }
+
+        runStart = k;
+        runCost = cost;
+    }
+
+    border.dirty = false;
+}
+
+void HierarchicalPathfinder::EnsureCluster(const ChunkedGrid<Cell>& grid, int clusterIndex)
+{
+    Cluster& cluster = clusters[clusterIndex];
+    if (!cluster.dirty) return;
+
+    cluster.nodes.clear();
+    for (int side = 0; side < 4; side++) {
+        cluster.offset[side] = (int)cluster.nodes.size();
+        if (cluster.border[side] < 0) continue;
+
+        EnsureBorder(grid, cluster.border[side]);
+        const Border& border = borders[cluster.border[side]];
+
+        // Transitions store the top/left cell; the top and left sides of
+        // this cluster are the bottom/right cell of the pair
+        for (int t = 0; t < (int)border.transitions.size(); t++) {
+            AbstractNode node;
+            node.i = border.transitions[t].i + (side == 0 ? 1 : 0);
+            node.j = border.transitions[t].j + (side == 3 ? 1 : 0);
+            node.side = side;
+            node.transition = t;
+            cluster.nodes.push_back(node);
+        }
+    }
+
+    int n = (int)cluster.nodes.size();
+    cluster.dist.assign((size_t)n * n, INF);
+    for (int a = 0; a < n; a++) {
+        LocalDijkstra(grid, cluster, cluster.nodes[a].i, cluster.nodes[a].j, false);
+        for (int b = 0; b < n; b++)
+            cluster.dist[a * n + b] = LocalDist(cluster, cluster.nodes[b].i, cluster.nodes[b].j);
+    }
+
+    cluster.stamp.assign(n, 0);
+    cluster.g.assign(n, INF);
+    cluster.parentCluster.assign(n, -1);
+    cluster.parentNode.assign(n, -1);
+    cluster.closed.assign(n, 0);
+    cluster.goalDist.assign(n, INF);
+
+    cluster.dirty = false;
+    builtClusters++;
+}
+
+void HierarchicalPathfinder::LocalDijkstra(const ChunkedGrid<Cell>& grid, const Cluster& cluster,
+    int si, int sj, bool reverse)
+{
+    // Forward distances pay for the cell being entered. Reverse distances
+    // give the cost of reaching (si, sj) from each cell, so a step from u to v
+    // pays for u, the cell that the forward path enters.
+    const PathCosts& costs = flat.costs;
+    int w = cluster.j1 - cluster.j0;
+    int h = cluster.i1 - cluster.i0;
+
+    localDist.assign((size_t)CLUSTER_SIZE * CLUSTER_SIZE, INF);
+    localHeap.clear();
+
+    std::greater<std::pair<int, int>> order;
+    int start = (si - cluster.i0) * CLUSTER_SIZE + (sj - cluster.j0);
+    localDist[start] = 0;
+    localHeap.push_back({ 0, start });
+
+    while (!localHeap.empty()) {
+        std::pop_heap(localHeap.begin(), localHeap.end(), order);
+        std::pair<int, int> cur = localHeap.back();
+        localHeap.pop_back();
+
+        if (cur.first != localDist[cur.second]) continue;
+
+        int li = cur.second / CLUSTER_SIZE;
+        int lj = cur.second % CLUSTER_SIZE;
+        int stepCost = reverse ? costs.For(grid.At(cluster.i0 + li, cluster.j0 + lj)) : 0;
+
+        for (int d = 0; d < 4; d++) {
+            int ni = li + DI[d];
+            int nj = lj + DJ[d];
+            if (ni < 0 || nj < 0 || ni >= h || nj >= w) continue;
+
+            int cost = reverse ? stepCost : costs.For(grid.At(cluster.i0 + ni, cluster.j0 + nj));
+            int next = ni * CLUSTER_SIZE + nj;
+            int dist = cur.first + cost;
+            if (dist >= localDist[next]) continue;
+
+            localDist[next] = dist;
+            localHeap.push_back({ dist, next });
+            std::push_heap(localHeap.begin(), localHeap.end(), order);
+        }
+    }
+}
+
+int HierarchicalPathfinder::LocalDist(const Cluster& cluster, int i, int j) const
+{
+    return localDist[(i - cluster.i0) * CLUSTER_SIZE + (j - cluster.j0)];
+}
+
+void HierarchicalPathfinder::PeerOf(int clusterIndex, const AbstractNode& node,
+    int& peerCluster, int& peerNode, int& peerI, int& peerJ) const
+{
+    int side = node.side;
+    int opposite = (side + 2) % 4;
+
+    peerCluster = clusterIndex + DI[side] * clustersX + DJ[side];
+    peerNode = clusters[peerCluster].offset[opposite] + node.transition;
+    peerI = node.i + DI[side];
+    peerJ = node.j + DJ[side];
+}
+
+/* =========================================================
+ *  Query
+ * ========================================================= */
+void HierarchicalPathfinder::Relax(int clusterIndex, int node, int g, int fromCluster, int fromNode,
+    int ti, int tj)
+{
+    Cluster& cluster = clusters[clusterIndex];
+    if (cluster.stamp[node] != generation) {
+        cluster.stamp[node] = generation;
+        cluster.g[node] = INF;
+        cluster.closed[node] = 0;
+    }
+
+    if (cluster.closed[node] || g >= cluster.g[node]) return;
+
+    cluster.g[node] = g;
+    cluster.parentCluster[node] = fromCluster;
+    cluster.parentNode[node] = fromNode;
+
+    const AbstractNode& n = cluster.nodes[node];
+    int h = (abs(n.i - ti) + abs(n.j - tj)) * heuristicScale / 100;
+    open.push_back({ g + h, g, clusterIndex, node });
+    std::push_heap(open.begin(), open.end(), OpenEntryOrder());
+}
+
+bool HierarchicalPathfinder::FindPath(const ChunkedGrid<Cell>& grid, int si, int sj, int ti, int tj,
+    std::vector<std::pair<int, int>>& outPath)
+{
+    lastAbstractExpanded = 0;
+
+    if (abs(si - ti) + abs(sj - tj) <= 2 * CLUSTER_SIZE)
+        return flat.FindPath(grid, si, sj, ti, tj, outPath);
+
+    if (grid.Width() != width || grid.Height() != height)
+        Reset(grid.Width(), grid.Height());
+
+    generation++;
+    if (generation == 0) {
+        for (Cluster& cluster : clusters)
+            std::fill(cluster.stamp.begin(), cluster.stamp.end(), 0);
+        generation = 1;
+    }
+
+    heuristicScale = flat.costs.Min() * flat.costs.heuristicWeight;
+
+    int startCluster = ClusterIndex(si, sj);
+    int goalCluster = ClusterIndex(ti, tj);
+    EnsureCluster(grid, startCluster);
+    EnsureCluster(grid, goalCluster);
+
+    // Cost from every goal cluster node to the goal
+    Cluster& goal = clusters[goalCluster];
+    LocalDijkstra(grid, goal, ti, tj, true);
+    for (int k = 0; k < (int)goal.nodes.size(); k++)
+        goal.goalDist[k] = LocalDist(goal, goal.nodes[k].i, goal.nodes[k].j);
+
+    open.clear();
+
+    const Cluster& start = clusters[startCluster];
+    LocalDijkstra(grid, start, si, sj, false);
+    for (int k = 0; k < (int)start.nodes.size(); k++) {
+        int d = LocalDist(start, start.nodes[k].i, start.nodes[k].j);
+        if (d < INF) Relax(startCluster, k, d, -1, -1, ti, tj);
+    }
+
+    OpenEntryOrder order;
+    int bestGoal = INF;
+    int goalParent = -1;
+    bool found = false;
+
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), order);
+        OpenEntry cur = open.back();
+        open.pop_back();
+
+        if (cur.node < 0) {
+            if (cur.g == bestGoal) {
+                found = true;
+                break;
+            }
+            continue;
+        }
+
+        Cluster& cluster = clusters[cur.cluster];
+        if (cluster.closed[cur.node] || cur.g != cluster.g[cur.node]) continue;
+        cluster.closed[cur.node] = 1;
+        lastAbstractExpanded++;
+
+        if (cur.cluster == goalCluster && goal.goalDist[cur.node] < INF) {
+            int total = cur.g + goal.goalDist[cur.node];
+            if (total < bestGoal) {
+                bestGoal = total;
+                goalParent = cur.node;
+                open.push_back({ total, total, goalCluster, -1 });
+                std::push_heap(open.begin(), open.end(), order);
+            }
+        }
+
+        int n = (int)cluster.nodes.size();
+        for (int m = 0; m < n; m++) {
+            int d = cluster.dist[cur.node * n + m];
+            if (m == cur.node || d >= INF) continue;
+            Relax(cur.cluster, m, cur.g + d, cur.cluster, cur.node, ti, tj);
+        }
+
+        const AbstractNode node = cluster.nodes[cur.node];
+        int peerCluster = cur.cluster + DI[node.side] * clustersX + DJ[node.side];
+        EnsureCluster(grid, peerCluster);
+
+        int peerNode, peerI, peerJ;
+        PeerOf(cur.cluster, node, peerCluster, peerNode, peerI, peerJ);
+        int cost = flat.costs.For(grid.At(peerI, peerJ));
+        Relax(peerCluster, peerNode, cur.g + cost, cur.cluster, cur.node, ti, tj);
+    }
+
+    if (!found) return false;
+
+    // Abstract node chain, start side first
+    abstractPath.clear();
+    for (int c = goalCluster, k = goalParent; c >= 0; ) {
+        abstractPath.push_back({ c, k });
+        int pc = clusters[c].parentCluster[k];
+        int pk = clusters[c].parentNode[k];
+        c = pc;
+        k = pk;
+    }
+    std::reverse(abstractPath.begin(), abstractPath.end());
+
+    // Refine every hop inside a cluster with a bounded search; hops between
+    // clusters are a single step across the border
+    outPath.clear();
+    outPath.push_back({ si, sj });
+
+    int ci = si, cj = sj;
+    int prevCluster = startCluster;
+    for (const auto& step : abstractPath) {
+        const AbstractNode& node = clusters[step.first].nodes[step.second];
+
+        if (step.first == prevCluster) {
+            if (!AppendSegment(grid, clusters[step.first], ci, cj, node.i, node.j, outPath))
+                return false;
+        }
+        else {
+            outPath.push_back({ node.i, node.j });
+        }
+
+        ci = node.i;
+        cj = node.j;
+        prevCluster = step.first;
+    }
+
+    if (!AppendSegment(grid, goal, ci, cj, ti, tj, outPath))
+        return false;
+
+    RemoveLoops(outPath);
+    return true;
+}
+
+bool HierarchicalPathfinder::AppendSegment(const ChunkedGrid<Cell>& grid, const Cluster& cluster,
+    int si, int sj, int ti, int tj, std::vector<std::pair<int, int>>& outPath)
+{
+    if (!flat.FindPath(grid, si, sj, ti, tj, cluster.i0, cluster.j0, cluster.i1 - 1, cluster.j1 - 1, segment))
+        return false;
+
+    outPath.insert(outPath.end(), segment.begin() + 1, segment.end());
+    return true;
+}
+
+void HierarchicalPathfinder::RemoveLoops(std::vector<std::pair<int, int>>& path)
+{
+    // Refined hops can meet again at a cluster corner; cut out any cycle so
+    // every cell appears once
+    if (pathMarks.empty()) {
+        PathMark unused = { 0, -1 };
+        pathMarks.assign((size_t)width * height, unused);
+    }
+
+    pathGeneration++;
+    if (pathGeneration == 0) {
+        for (PathMark& mark : pathMarks) mark.stamp = 0;
+        pathGeneration = 1;
+    }
+
+    size_t w = 0;
+    for (size_t k = 0; k < path.size(); k++) {
+        PathMark& mark = pathMarks[(size_t)path[k].first * width + path[k].second];
+
+        if (mark.stamp == pathGeneration && mark.index >= 0) {
+            size_t keep = (size_t)mark.index + 1;
+            for (size_t r = keep; r < w; r++)
+                pathMarks[(size_t)path[r].first * width + path[r].second].index = -1;
+            w = keep;
+            continue;
+        }
+
+        mark.stamp = pathGeneration;
+        mark.index = (int)w;
+        path[w++] = path[k];
+    }
+
+    path.resize(w);
+}
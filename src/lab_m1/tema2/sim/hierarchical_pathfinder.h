@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "lab_m1/tema2/sim/chunked_grid.h"
+#include "lab_m1/tema2/sim/pathfinder.h"
+#include "lab_m1/tema2/sim/sim_types.h"
+
+
+namespace m1
+{
+    // HPA* on top of Pathfinder. The map is cut into CLUSTER_SIZE square
+    // clusters. Every border between two clusters gets transition points, one
+    // per run of equally expensive cells, and each cluster stores the cost
+    // between every pair of its transition points. A long query searches that
+    // small abstract graph and then refines only the chosen hops with A*
+    // bounded to one cluster.
+    //
+    // Borders and clusters are built lazily the first time a search reaches
+    // them. InvalidateCell marks the cluster holding the cell, and the
+    // neighbouring cluster if the cell is on a border, for a rebuild.
+    class HierarchicalPathfinder
+    {
+    public:
+        static constexpr int CLUSTER_SIZE = 32;
+
+        HierarchicalPathfinder();
+
+        void Reset(int width, int height);
+        void InvalidateCell(int i, int j);
+
+        // Same contract as Pathfinder::FindPath. Queries shorter than two
+        // clusters go straight to the flat search.
+        bool FindPath(const ChunkedGrid<Cell>& grid, int si, int sj, int ti, int tj,
+            std::vector<std::pair<int, int>>& outPath);
+
+        void SetCosts(const PathCosts& pathCosts);
+        const PathCosts& GetCosts() const { return flat.costs; }
+
+        int LastAbstractExpanded() const { return lastAbstractExpanded; }
+        // Number of cluster (re)builds since the last Reset
+        int BuiltClusters() const { return builtClusters; }
+
+    private:
+        static constexpr int INF = 0x3fffffff;
+
+        // A transition joins cell (i, j) on the top/left cluster with the
+        // adjacent cell on the bottom/right cluster.
+        struct Transition
+        {
+            int i, j;
+        };
+
+        struct Border
+        {
+            bool dirty = true;
+            bool horizontal = false;
+            std::vector<Transition> transitions;
+        };
+
+        struct AbstractNode
+        {
+            int i, j;
+            int side;       // 0 top, 1 right, 2 bottom, 3 left
+            int transition;
+        };
+
+        struct Cluster
+        {
+            bool dirty = true;
+            int i0, j0, i1, j1;
+            int border[4];          // border index per side, -1 on the map edge
+            int offset[4];          // first node of each side in nodes
+            std::vector<AbstractNode> nodes;
+            std::vector<int> dist;  // nodes.size()^2, INF when unreachable
+
+            // Search scratch, valid when stamp == generation
+            std::vector<uint32_t> stamp;
+            std::vector<int> g;
+            std::vector<int> parentCluster;
+            std::vector<int> parentNode;
+            std::vector<unsigned char> closed;
+            std::vector<int> goalDist;
+        };
+
+        struct OpenEntry
+        {
+            int f, g;
+            int cluster, node;      // node -1 is the goal
+        };
+
+        // Position of a cell in the path being cut, valid when stamp ==
+        // pathGeneration and index >= 0
+        struct PathMark
+        {
+            uint32_t stamp;
+            int index;
+        };
+
+        struct OpenEntryOrder
+        {
+            bool operator()(const OpenEntry& a, const OpenEntry& b) const
+            {
+                if (a.f != b.f) return a.f > b.f;
+                if (a.g != b.g) return a.g < b.g;
+                if (a.cluster != b.cluster) return a.cluster > b.cluster;
+                return a.node > b.node;
+            }
+        };
+
+        int ClusterIndex(int i, int j) const
+        {
+            return (i / CLUSTER_SIZE) * clustersX + (j / CLUSTER_SIZE);
+        }
+
+        void EnsureBorder(const ChunkedGrid<Cell>& grid, int borderIndex);
+        void EnsureCluster(const ChunkedGrid<Cell>& grid, int clusterIndex);
+        void LocalDijkstra(const ChunkedGrid<Cell>& grid, const Cluster& cluster,
+            int si, int sj, bool reverse);
+        int LocalDist(const Cluster& cluster, int i, int j) const;
+        void PeerOf(int clusterIndex, const AbstractNode& node, int& peerCluster, int& peerNode,
+            int& peerI, int& peerJ) const;
+        void Relax(int clusterIndex, int node, int g, int fromCluster, int fromNode, int ti, int tj);
+        bool AppendSegment(const ChunkedGrid<Cell>& grid, const Cluster& cluster,
+            int si, int sj, int ti, int tj, std::vector<std::pair<int, int>>& outPath);
+        void RemoveLoops(std::vector<std::pair<int, int>>& path);
+
+        int width, height;
+        int clustersX, clustersY;
+        std::vector<Cluster> clusters;
+        std::vector<Border> borders;    // horizontal borders first, then vertical
+        int horizontalBorders;
+
+        Pathfinder flat;
+        std::vector<std::pair<int, int>> segment;
+
+        std::vector<int> localDist;
+        std::vector<std::pair<int, int>> localHeap;
+
+        uint32_t generation;
+        int heuristicScale;
+        std::vector<OpenEntry> open;
+        std::vector<std::pair<int, int>> abstractPath;
+        std::vector<PathMark> pathMarks;   // per cell, allocated on first use
+        uint32_t pathGeneration;
+
+        int lastAbstractExpanded;
+        int builtClusters;
+    };
+}
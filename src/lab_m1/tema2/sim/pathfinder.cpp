@@ -0,0 +1,197 @@
+#include "lab_m1/tema2/sim/pathfinder.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+using namespace m1;
+
+
+namespace
+{
+    const int DI[4] = { -1, 0, 1, 0 };
+    const int DJ[4] = { 0, 1, 0, -1 };
+    const uint32_t CLOSED = 1 << 2;
+    const uint32_t DIR_MASK = 3;
+}
+
+
+Pathfinder::Pathfinder()
+{
+    width = height = 0;
+    tilesX = tilesY = 0;
+    generation = 0;
+    bucketMask = 0;
+    openCount = 0;
+    minBucket = maxBucket = 0;
+    lastCost = 0;
+    lastExpanded = 0;
+}
+
+void Pathfinder::Resize(int w, int h)
+{
+    if (w == width && h == height) return;
+
+    width = w;
+    height = h;
+    tilesX = (w + TILE_MASK) >> TILE_SHIFT;
+    tilesY = (h + TILE_MASK) >> TILE_SHIFT;
+    generation = 0;
+
+    Node empty = { 0, 0 };
+    nodes.assign(((size_t)tilesX * tilesY) << (2 * TILE_SHIFT), empty);
+}
+
+void Pathfinder::NextGeneration()
+{
+    generation++;
+
+    // Stamps wrapped around, so old nodes could look current again
+    if (generation == 0) {
+        for (Node& node : nodes) node.stamp = 0;
+        generation = 1;
+    }
+}
+
+void Pathfinder::ResetOpen(int span, int startF)
+{
+    // The ring keeps the size of the widest query so far, always a power
+    // of two
+    int size = 1;
+    while (size <= span) size <<= 1;
+    if ((int)buckets.size() < size) buckets.resize(size);
+    bucketMask = (int)buckets.size() - 1;
+
+    openCount = 0;
+    minBucket = maxBucket = startF;
+}
+
+void Pathfinder::GrowOpen(int span)
+{
+    int size = bucketMask + 1;
+    while (size <= span) size <<= 1;
+
+    std::vector<std::vector<OpenNode>> grown(size);
+    for (int f = minBucket; f <= maxBucket; f++)
+        grown[f & (size - 1)].swap(buckets[f & bucketMask]);
+
+    buckets.swap(grown);
+    bucketMask = size - 1;
+}
+
+void Pathfinder::PushOpen(int f, const OpenNode& node)
+{
+    // A weighted heuristic is not consistent, so f can dip below the bucket
+    // currently being drained
+    int low = std::min(minBucket, f);
+    int high = std::max(maxBucket, f);
+    if (high - low > bucketMask) GrowOpen(high - low);
+    minBucket = low;
+    maxBucket = high;
+
+    buckets[f & bucketMask].push_back(node);
+    openCount++;
+}
+
+bool Pathfinder::PopOpen(OpenNode& node)
+{
+    if (openCount == 0) return false;
+
+    while (buckets[minBucket & bucketMask].empty()) minBucket++;
+
+    std::vector<OpenNode>& bucket = buckets[minBucket & bucketMask];
+    node = bucket.back();
+    bucket.pop_back();
+    openCount--;
+    return true;
+}
+
+bool Pathfinder::FindPath(const ChunkedGrid<Cell>& grid, int si, int sj, int ti, int tj,
+    std::vector<std::pair<int, int>>& outPath)
+{
+    return FindPath(grid, si, sj, ti, tj, 0, 0, grid.Height() - 1, grid.Width() - 1, outPath);
+}
+
+bool Pathfinder::FindPath(const ChunkedGrid<Cell>& grid, int si, int sj, int ti, int tj,
+    int minI, int minJ, int maxI, int maxJ,
+    std::vector<std::pair<int, int>>& outPath)
+{
+    Resize(grid.Width(), grid.Height());
+    NextGeneration();
+
+    lastCost = 0;
+    lastExpanded = 0;
+
+    const int hScale = costs.Min() * costs.heuristicWeight;
+
+    int startF = (abs(si - ti) + abs(sj - tj)) * hScale / 100;
+
+    // One step adds its cell cost to g and moves the heuristic by one cell,
+    // rounding included
+    ResetOpen(costs.Max() + hScale / 100 + 1, startF);
+
+    Node& startNode = nodes[NodeIndex(si, sj)];
+    startNode.stamp = generation;
+    startNode.state = 0;
+    PushOpen(startF, { 0, si, sj });
+
+    OpenNode cur;
+    bool found = false;
+
+    while (PopOpen(cur)) {
+        // Stale entry left behind by a later, cheaper push
+        Node& node = nodes[NodeIndex(cur.i, cur.j)];
+        if (node.state & CLOSED) continue;
+        if ((int)(node.state >> 3) != cur.g) continue;
+
+        node.state |= CLOSED;
+        lastExpanded++;
+
+        if (cur.i == ti && cur.j == tj) {
+            found = true;
+            break;
+        }
+
+        for (int d = 0; d < 4; d++) {
+            int ni = cur.i + DI[d];
+            int nj = cur.j + DJ[d];
+
+            if (ni < minI || nj < minJ || ni > maxI || nj > maxJ) continue;
+
+            Node& next = nodes[NodeIndex(ni, nj)];
+            int g = cur.g + costs.For(grid.At(ni, nj));
+
+            if (next.stamp == generation) {
+                if (next.state & CLOSED) continue;
+                if (g >= (int)(next.state >> 3)) continue;
+            }
+
+            next.stamp = generation;
+            next.state = ((uint32_t)g << 3) | (uint32_t)d;
+
+            int h = (abs(ni - ti) + abs(nj - tj)) * hScale / 100;
+            PushOpen(g + h, { g, ni, nj });
+        }
+    }
+
+    // Leave the buckets empty but allocated for the next query
+    for (int f = minBucket; f <= maxBucket; f++)
+        buckets[f & bucketMask].clear();
+
+    if (!found) return false;
+
+    lastCost = (int)(nodes[NodeIndex(ti, tj)].state >> 3);
+
+    outPath.clear();
+    int ci = ti, cj = tj;
+    while (!(ci == si && cj == sj)) {
+        outPath.push_back({ ci, cj });
+        int d = nodes[NodeIndex(ci, cj)].state & DIR_MASK;
+        ci -= DI[d];
+        cj -= DJ[d];
+    }
+    outPath.push_back({ si, sj });
+
+    std::reverse(outPath.begin(), outPath.end());
+    return true;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "lab_m1/tema2/sim/chunked_grid.h"
+#include "lab_m1/tema2/sim/sim_types.h"
+
+
+namespace m1
+{
+    // Cost of laying one cell of track on each terrain. Water needs a bridge
+    // and mountains a tunnel, so they cost more than plain grass. Cells that
+    // already hold track cost extra: a new line may only cross them straight,
+    // otherwise BuildRailPath rejects the junction.
+    struct PathCosts
+    {
+        int grass = 10;
+        int water = 40;
+        int mountain = 30;
+        int rail = 50;
+
+        // Heuristic weight in percent. 100 always finds the cheapest path;
+        // larger values trade optimality for far fewer expanded cells when a
+        // river or mountain range sits between the two ends.
+        int heuristicWeight = 100;
+
+        int For(const Cell& cell) const
+        {
+            int cost = grass;
+            if (cell.Type() == CellType::Water) cost = water;
+            else if (cell.Type() == CellType::Mountain) cost = mountain;
+            if (cell.RailMask()) cost += rail;
+            return cost;
+        }
+
+        int Min() const
+        {
+            int m = grass;
+            if (water < m) m = water;
+            if (mountain < m) m = mountain;
+            return m;
+        }
+
+        int Max() const
+        {
+            int m = grass;
+            if (water > m) m = water;
+            if (mountain > m) m = mountain;
+            return m + rail;
+        }
+    };
+
+    // A* over the 4-connected map grid. The per-cell scratch nodes are
+    // allocated once for the map size and reused: a node is only valid when
+    // its stamp equals the current query generation, so starting a new query
+    // just bumps the generation instead of clearing anything. Nodes are laid
+    // out in 64x64 tiles so that neighbouring cells share pages.
+    //
+    // Costs are small integers, so the open list is a bucket queue indexed by
+    // f. Each bucket is a stack, which favours the most recently reached
+    // (deepest) node among equal f values. One step raises f by at most the
+    // largest cell cost plus one heuristic step, so the buckets form a ring
+    // of about that many and are reused as f grows. A weighted heuristic
+    // lets the open f values spread further; the ring doubles when it must.
+    class Pathfinder
+    {
+    public:
+        Pathfinder();
+
+        void Resize(int width, int height);
+
+        // Finds the cheapest path between two cells, optionally restricted
+        // to the rectangle [minI, maxI] x [minJ, maxJ]. outPath goes from the
+        // start cell to the target cell, both included.
+        bool FindPath(const ChunkedGrid<Cell>& grid, int si, int sj, int ti, int tj,
+            std::vector<std::pair<int, int>>& outPath);
+        bool FindPath(const ChunkedGrid<Cell>& grid, int si, int sj, int ti, int tj,
+            int minI, int minJ, int maxI, int maxJ,
+            std::vector<std::pair<int, int>>& outPath);
+
+        // Cost of the last path found, in PathCosts units
+        int LastCost() const { return lastCost; }
+        int LastExpanded() const { return lastExpanded; }
+
+        PathCosts costs;
+
+    private:
+        static constexpr int TILE_SHIFT = 6;
+        static constexpr int TILE_MASK = (1 << TILE_SHIFT) - 1;
+
+        struct Node
+        {
+            uint32_t stamp;
+            uint32_t state;     // g << 3 | closed << 2 | direction we came from
+        };
+
+        struct OpenNode
+        {
+            int g;
+            int i, j;
+        };
+
+        size_t NodeIndex(int i, int j) const
+        {
+            size_t tile = (size_t)(i >> TILE_SHIFT) * tilesX + (j >> TILE_SHIFT);
+            return (tile << (2 * TILE_SHIFT)) | ((i & TILE_MASK) << TILE_SHIFT) | (j & TILE_MASK);
+        }
+
+        void NextGeneration();
+        void ResetOpen(int span, int startF);
+        void GrowOpen(int span);
+        void PushOpen(int f, const OpenNode& node);
+        bool PopOpen(OpenNode& node);
+
+        int width, height;
+        int tilesX, tilesY;
+        uint32_t generation;
+        std::vector<Node> nodes;
+        std::vector<std::vector<OpenNode>> buckets;   // ring, f & bucketMask
+        int bucketMask;
+        int openCount;
+        int minBucket, maxBucket;                   // f, not ring index
+
+        int lastCost;
+        int lastExpanded;
+    };
+}
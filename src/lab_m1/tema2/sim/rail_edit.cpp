@@ -0,0 +1,115 @@
+#include "lab_m1/tema2/sim/rail_edit.h"
+
+using namespace std;
+using namespace m1;
+
+
+RailEdit::RailEdit()
+{
+    grid = nullptr;
+    stamp = 0;
+}
+
+void RailEdit::Begin(const ChunkedGrid<Cell>& target)
+{
+    grid = &target;
+    deltas.clear();
+    stamp++;
+
+    if (slots.empty()) Rehash(64);
+}
+
+void RailEdit::Clear()
+{
+    deltas.clear();
+    stamp++;
+}
+
+unsigned char RailEdit::MaskAt(int i, int j) const
+{
+    int k = Find(i, j);
+    return k >= 0 ? deltas[k].after : grid->At(i, j).RailMask();
+}
+
+bool RailEdit::Connect(int i1, int j1, int i2, int j2)
+{
+    int dir;
+    if (i2 == i1 - 1 && j2 == j1) dir = 0;
+    else if (i2 == i1 && j2 == j1 + 1) dir = 1;
+    else if (i2 == i1 + 1 && j2 == j1) dir = 2;
+    else if (i2 == i1 && j2 == j1 - 1) dir = 3;
+    else return true;
+
+    unsigned char mask1 = MaskAt(i1, j1) | DirToMask(dir);
+    unsigned char mask2 = MaskAt(i2, j2) | DirToMask(OppositeDir(dir));
+    if (CountBits(mask1) == 3 || CountBits(mask2) == 3) return false;
+
+    Touch(i1, j1).after = mask1;
+    Touch(i2, j2).after = mask2;
+    return true;
+}
+
+uint32_t RailEdit::CellKey(int i, int j) const
+{
+    return (uint32_t)i * (uint32_t)grid->Width() + (uint32_t)j;
+}
+
+size_t RailEdit::HomeSlot(uint32_t cell) const
+{
+    // Fibonacci hashing, so neighbouring cells spread over the table
+    return (size_t)(cell * 2654435761u) & (slots.size() - 1);
+}
+
+int RailEdit::Find(int i, int j) const
+{
+    uint32_t cell = CellKey(i, j);
+    size_t mask = slots.size() - 1;
+
+    for (size_t s = HomeSlot(cell); ; s = (s + 1) & mask) {
+        const Slot& slot = slots[s];
+        if (slot.stamp != stamp) return -1;
+        if (slot.cell == cell) return slot.delta;
+    }
+}
+
+RailEdit::Delta& RailEdit::Touch(int i, int j)
+{
+    int k = Find(i, j);
+    if (k >= 0) return deltas[k];
+
+    // Keep the table at most half full
+    if ((deltas.size() + 1) * 2 > slots.size()) Rehash(slots.size() * 2);
+
+    Delta delta;
+    delta.i = i;
+    delta.j = j;
+    delta.before = delta.after = grid->At(i, j).RailMask();
+    deltas.push_back(delta);
+
+    uint32_t cell = CellKey(i, j);
+    size_t mask = slots.size() - 1;
+    size_t s = HomeSlot(cell);
+    while (slots[s].stamp == stamp) s = (s + 1) & mask;
+
+    slots[s].cell = cell;
+    slots[s].stamp = stamp;
+    slots[s].delta = (int)deltas.size() - 1;
+    return deltas.back();
+}
+
+void RailEdit::Rehash(size_t count)
+{
+    slots.assign(count, Slot());
+    for (Slot& slot : slots) slot.stamp = stamp - 1;
+
+    size_t mask = count - 1;
+    for (int k = 0; k < (int)deltas.size(); k++) {
+        uint32_t cell = CellKey(deltas[k].i, deltas[k].j);
+        size_t s = HomeSlot(cell);
+        while (slots[s].stamp == stamp) s = (s + 1) & mask;
+
+        slots[s].cell = cell;
+        slots[s].stamp = stamp;
+        slots[s].delta = k;
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "lab_m1/tema2/sim/chunked_grid.h"
+#include "lab_m1/tema2/sim/sim_types.h"
+
+
+namespace m1
+{
+    // Pending rail changes on top of a grid. Only the touched cells are
+    // recorded, with their mask before and after, and reads go through that
+    // overlay, so validating a path costs its length rather than a copy of
+    // the map. Commit() hands the changed cells to the owner, which applies
+    // them with its own bookkeeping; Rollback() drops them.
+    //
+    // Buffers are kept between edits; once they have grown to the longest
+    // path seen, an edit allocates nothing.
+    class RailEdit
+    {
+    public:
+        struct Delta
+        {
+            int i, j;
+            unsigned char before, after;
+        };
+
+        RailEdit();
+
+        void Begin(const ChunkedGrid<Cell>& grid);
+        void Rollback() { Clear(); }
+
+        // Calls apply(i, j, mask) for every cell whose mask changed, then
+        // ends the edit
+        template <typename Apply>
+        void Commit(Apply apply)
+        {
+            for (const Delta& delta : deltas)
+                if (delta.after != delta.before) apply(delta.i, delta.j, delta.after);
+            Clear();
+        }
+
+        // Rail mask of a cell as the edit would leave it
+        unsigned char MaskAt(int i, int j) const;
+
+        // Lays track between two neighbouring cells. Fails, leaving the edit
+        // as it was, when either cell would become a three-way junction.
+        // Cells that are not neighbours are ignored.
+        bool Connect(int i1, int j1, int i2, int j2);
+
+        const std::vector<Delta>& Deltas() const { return deltas; }
+
+    private:
+        void Clear();
+        uint32_t CellKey(int i, int j) const;
+        size_t HomeSlot(uint32_t cell) const;
+        int Find(int i, int j) const;
+        Delta& Touch(int i, int j);
+        void Rehash(size_t slots);
+
+        const ChunkedGrid<Cell>* grid;
+        std::vector<Delta> deltas;
+
+        // Open addressing from cell to delta index. A slot belongs to the
+        // current edit only if it carries its stamp, so starting an edit
+        // does not clear the table.
+        struct Slot
+        {
+            uint32_t cell;
+            uint32_t stamp;
+            int delta;
+        };
+        std::vector<Slot> slots;
+        uint32_t stamp;
+    };
+}
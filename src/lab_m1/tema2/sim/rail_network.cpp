@@ -0,0 +1,453 @@
+#include "lab_m1/tema2/sim/rail_network.h"
+
+using namespace std;
+using namespace m1;
+
+
+namespace
+{
+    const int DI[4] = { -1, 0, 1, 0 };
+    const int DJ[4] = { 0, 1, 0, -1 };
+
+    int FirstDir(unsigned char mask)
+    {
+        for (int d = 0; d < 4; d++)
+            if (mask & DirToMask(d)) return d;
+        return -1;
+    }
+}
+
+
+RailNetwork::RailNetwork()
+{
+    lastRebuiltEdges = 0;
+    splitPending = false;
+    visitStamp = 0;
+}
+
+void RailNetwork::Reset(int width, int height)
+{
+    links.Assign(width, height, CellLink());
+    nodes.clear();
+    edges.clear();
+    freeNodes.clear();
+    freeEdges.clear();
+    dirtyCells.clear();
+    lastRebuiltEdges = 0;
+    changedNodes.clear();
+
+    nodeSet.clear();
+    setParent.clear();
+    setSize.clear();
+    splitPending = false;
+    visited.clear();
+    visitStamp = 0;
+}
+
+void RailNetwork::InvalidateCell(int i, int j, bool removedTrack)
+{
+    dirtyCells.push_back({ i, j });
+    if (removedTrack) splitPending = true;
+}
+
+/* =========================================================
+ *  Incremental rebuild
+ * ========================================================= */
+void RailNetwork::Sync(const ChunkedGrid<Cell>& grid)
+{
+    if (dirtyCells.empty()) return;
+
+    lastRebuiltEdges = 0;
+    seeds.clear();
+
+    for (const auto& c : dirtyCells) {
+        CellLink link = links.At(c.first, c.second);
+        if (link.edge >= 0) KillEdge(link.edge);
+        if (link.node >= 0) KillNode(link.node);
+        seeds.push_back(c);
+    }
+    dirtyCells.clear();
+
+    // Killing an edge seeds both its end nodes, so every exit that lost its
+    // edge gets walked again
+    for (size_t k = 0; k < seeds.size(); k++)
+        CoverCell(grid, seeds[k].first, seeds[k].second);
+
+    if (splitPending) {
+        SplitComponents();
+        splitPending = false;
+    }
+}
+
+void RailNetwork::CoverCell(const ChunkedGrid<Cell>& grid, int i, int j)
+{
+    const Cell& cell = grid.At(i, j);
+    if (cell.RailMask() == 0) return;
+
+    const CellLink& link = links.At(i, j);
+    if (IsNodeCell(cell) || link.node >= 0) {
+        EnsureNode(grid, i, j);
+    }
+    else if (link.edge < 0) {
+        // Plain track that no edge covers: follow it to the nearest node.
+        // A closed loop without any node gets one at the starting cell.
+        int ci = i, cj = j;
+        int dir = FirstDir(cell.RailMask());
+        bool promote = true;
+
+        while (true) {
+            int ni = ci + DI[dir];
+            int nj = cj + DJ[dir];
+            if (!grid.InBounds(ni, nj)) break;
+
+            const Cell& next = grid.At(ni, nj);
+            if (!(next.RailMask() & DirToMask(OppositeDir(dir)))) break;
+            if (ni == i && nj == j) break;
+
+            if (IsNodeCell(next) || links.At(ni, nj).node >= 0) {
+                EnsureNode(grid, ni, nj);
+                promote = false;
+                break;
+            }
+
+            dir = FirstDir(next.RailMask() & ~DirToMask(OppositeDir(dir)));
+            ci = ni;
+            cj = nj;
+        }
+
+        if (promote) EnsureNode(grid, i, j);
+    }
+
+    while (!pendingNodes.empty()) {
+        int node = pendingNodes.back();
+        pendingNodes.pop_back();
+
+        for (int d = 0; d < 4; d++)
+            if ((nodes[node].mask & DirToMask(d)) && nodes[node].exits[d] < 0)
+                WalkEdge(grid, node, d);
+    }
+}
+
+int RailNetwork::EnsureNode(const ChunkedGrid<Cell>& grid, int i, int j)
+{
+    CellLink link = links.At(i, j);
+    if (link.node >= 0) return link.node;
+    if (link.edge >= 0) KillEdge(link.edge);
+
+    int id;
+    if (!freeNodes.empty()) {
+        id = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else {
+        id = (int)nodes.size();
+        nodes.push_back(Node());
+        nodes.back().version = 0;
+        nodeSet.push_back(-1);
+    }
+    nodeSet[id] = NewSet();
+    changedNodes.push_back(id);
+
+    Node& node = nodes[id];
+    node.i = i;
+    node.j = j;
+    node.mask = grid.At(i, j).RailMask();
+    node.alive = true;
+    node.version++;
+    for (int d = 0; d < 4; d++) node.exits[d] = -1;
+
+    CellLink nodeLink;
+    nodeLink.node = id;
+    links.Set(i, j, nodeLink);
+
+    pendingNodes.push_back(id);
+    return id;
+}
+
+void RailNetwork::KillNode(int id)
+{
+    Node& node = nodes[id];
+    if (!node.alive) return;
+
+    for (int d = 0; d < 4; d++)
+        if (node.exits[d] >= 0) KillEdge(node.exits[d] >> 1);
+
+    node.alive = false;
+    links.Set(node.i, node.j, CellLink());
+    freeNodes.push_back(id);
+    changedNodes.push_back(id);
+}
+
+void RailNetwork::KillEdge(int id)
+{
+    Edge& edge = edges[id];
+    if (!edge.alive) return;
+
+    edge.alive = false;
+    edge.version++;
+
+    for (int k = 1; k < edge.Length(); k++)
+        links.Set(edge.cells[k].first, edge.cells[k].second, CellLink());
+
+    int ends[2] = { edge.from, edge.to };
+    for (int node : ends) {
+        for (int d = 0; d < 4; d++)
+            if (nodes[node].exits[d] >= 0 && (nodes[node].exits[d] >> 1) == id)
+                nodes[node].exits[d] = -1;
+        seeds.push_back({ nodes[node].i, nodes[node].j });
+        changedNodes.push_back(node);
+    }
+
+    freeEdges.push_back(id);
+}
+
+void RailNetwork::WalkEdge(const ChunkedGrid<Cell>& grid, int from, int startDir)
+{
+    int id;
+    if (!freeEdges.empty()) {
+        id = freeEdges.back();
+        freeEdges.pop_back();
+    }
+    else {
+        id = (int)edges.size();
+        edges.push_back(Edge());
+        edges[id].version = 0;
+    }
+
+    Edge& edge = edges[id];
+    edge.cells.clear();
+    edge.dirs.clear();
+
+    int ci = nodes[from].i, cj = nodes[from].j;
+    int dir = startDir;
+    edge.cells.push_back({ ci, cj });
+
+    while (true) {
+        int ni = ci + DI[dir];
+        int nj = cj + DJ[dir];
+
+        // The track stops without a matching rail on the other side; leave
+        // the exit empty so trains turn around here
+        if (!grid.InBounds(ni, nj) || !(grid.At(ni, nj).RailMask() & DirToMask(OppositeDir(dir)))) {
+            edge.alive = false;
+            freeEdges.push_back(id);
+            return;
+        }
+
+        edge.dirs.push_back((unsigned char)dir);
+        edge.cells.push_back({ ni, nj });
+
+        const Cell& next = grid.At(ni, nj);
+        if (IsNodeCell(next) || links.At(ni, nj).node >= 0) break;
+
+        dir = FirstDir(next.RailMask() & ~DirToMask(OppositeDir(dir)));
+        ci = ni;
+        cj = nj;
+    }
+
+    int arrival = edge.dirs.back();
+    std::pair<int, int> end = edge.cells.back();
+    int to = EnsureNode(grid, end.first, end.second);
+
+    Edge& built = edges[id];
+    built.from = from;
+    built.to = to;
+    built.alive = true;
+
+    nodes[from].exits[startDir] = id * 2;
+    nodes[to].exits[OppositeDir(arrival)] = id * 2 + 1;
+    UnionNodes(from, to);
+    changedNodes.push_back(from);
+    changedNodes.push_back(to);
+
+    for (int k = 1; k < built.Length(); k++) {
+        CellLink link;
+        link.edge = id;
+        link.offset = k;
+        links.Set(built.cells[k].first, built.cells[k].second, link);
+    }
+
+    lastRebuiltEdges++;
+}
+
+/* =========================================================
+ *  Connectivity
+ * ========================================================= */
+bool RailNetwork::Connected(int i1, int j1, int i2, int j2) const
+{
+    int a = NodeAt(i1, j1);
+    int b = NodeAt(i2, j2);
+    if (a < 0 || b < 0) return false;
+
+    return FindSet(nodeSet[a]) == FindSet(nodeSet[b]);
+}
+
+int RailNetwork::ComponentCount() const
+{
+    int count = 0;
+    for (int id = 0; id < (int)nodes.size(); id++)
+        if (nodes[id].alive && FindSet(nodeSet[id]) == nodeSet[id]) count++;
+    return count;
+}
+
+int RailNetwork::NodeAt(int i, int j) const
+{
+    if (!links.InBounds(i, j)) return -1;
+
+    // Plain track belongs to the component of the nodes its edge joins
+    const CellLink& link = links.At(i, j);
+    if (link.node >= 0) return link.node;
+    if (link.edge >= 0) return edges[link.edge].from;
+    return -1;
+}
+
+int RailNetwork::NodeIdAt(int i, int j) const
+{
+    if (!links.InBounds(i, j)) return -1;
+    return links.At(i, j).node;
+}
+
+int RailNetwork::Neighbour(int node, int dir) const
+{
+    int half = nodes[node].exits[dir];
+    if (half < 0) return -1;
+
+    const Edge& edge = edges[half >> 1];
+    return (half & 1) ? edge.from : edge.to;
+}
+
+int RailNetwork::NewSet()
+{
+    setParent.push_back((int)setParent.size());
+    setSize.push_back(1);
+    return (int)setParent.size() - 1;
+}
+
+int RailNetwork::FindSet(int set) const
+{
+    while (setParent[set] != set) set = setParent[set];
+    return set;
+}
+
+void RailNetwork::UnionNodes(int a, int b)
+{
+    int x = FindSet(nodeSet[a]);
+    int y = FindSet(nodeSet[b]);
+    if (x == y) return;
+
+    if (setSize[x] < setSize[y]) std::swap(x, y);
+    setParent[y] = x;
+    setSize[x] += setSize[y];
+
+    // Point both nodes straight at the root, so chains stay short
+    setParent[nodeSet[a]] = x;
+    setParent[nodeSet[b]] = x;
+}
+
+void RailNetwork::SplitComponents()
+{
+    visited.resize(nodes.size(), 0);
+    visitStamp++;
+
+    // Elements are never reused, so once most of them are stale start over
+    // and relabel the whole network
+    if (setParent.size() > 4 * nodes.size() + 1024) {
+        setParent.clear();
+        setSize.clear();
+        for (int id = 0; id < (int)nodes.size(); id++)
+            if (nodes[id].alive && visited[id] != visitStamp) LabelComponent(id);
+        return;
+    }
+
+    // Every node of a component that lost track can still reach one of the
+    // seeds: the ends of the removed edges and the rebuilt cells. Walking
+    // from them gives each piece left over a fresh set.
+    for (const auto& seed : seeds) {
+        int start = NodeAt(seed.first, seed.second);
+        if (start >= 0 && nodes[start].alive && visited[start] != visitStamp) LabelComponent(start);
+    }
+}
+
+void RailNetwork::LabelComponent(int start)
+{
+    int set = NewSet();
+    walkQueue.clear();
+    walkQueue.push_back(start);
+    visited[start] = visitStamp;
+
+    for (size_t k = 0; k < walkQueue.size(); k++) {
+        int node = walkQueue[k];
+        nodeSet[node] = set;
+
+        for (int d = 0; d < 4; d++) {
+            int next = Neighbour(node, d);
+            if (next < 0 || visited[next] == visitStamp) continue;
+
+            visited[next] = visitStamp;
+            walkQueue.push_back(next);
+        }
+    }
+    setSize[set] = (int)walkQueue.size();
+}
+
+/* =========================================================
+ *  Cursors
+ * ========================================================= */
+bool RailNetwork::Locate(int i, int j, int dir, RailCursor& cursor) const
+{
+    if (!links.InBounds(i, j)) return false;
+
+    const CellLink& link = links.At(i, j);
+    int half = -1;
+    int offset = 0;
+
+    if (link.node >= 0) {
+        half = nodes[link.node].exits[dir];
+    }
+    else if (link.edge >= 0) {
+        const Edge& edge = edges[link.edge];
+        if (edge.dirs[link.offset] == dir) {
+            half = link.edge * 2;
+            offset = link.offset;
+        }
+        else if (OppositeDir(edge.dirs[link.offset - 1]) == dir) {
+            half = link.edge * 2 + 1;
+            offset = edge.Length() - link.offset;
+        }
+    }
+
+    if (half < 0) return false;
+
+    cursor.edge = half >> 1;
+    cursor.reversed = (half & 1) != 0;
+    cursor.offset = offset;
+    cursor.version = edges[cursor.edge].version;
+    return true;
+}
+
+bool RailNetwork::IsValid(const RailCursor& cursor) const
+{
+    if (cursor.edge < 0 || cursor.edge >= (int)edges.size()) return false;
+
+    const Edge& edge = edges[cursor.edge];
+    return edge.alive && edge.version == cursor.version;
+}
+
+void RailNetwork::CursorCell(const RailCursor& cursor, int& i, int& j, int& dir) const
+{
+    const Edge& edge = edges[cursor.edge];
+    int length = edge.Length();
+    int k = cursor.offset;
+
+    if (!cursor.reversed) {
+        i = edge.cells[k].first;
+        j = edge.cells[k].second;
+        dir = edge.dirs[k < length ? k : length - 1];
+    }
+    else {
+        int index = length - k;
+        i = edge.cells[index].first;
+        j = edge.cells[index].second;
+        dir = OppositeDir(edge.dirs[index > 0 ? index - 1 : 0]);
+    }
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "lab_m1/tema2/sim/chunked_grid.h"
+#include "lab_m1/tema2/sim/sim_types.h"
+
+
+namespace m1
+{
+    // Graph compiled from the per-cell rail masks. Stations, junctions,
+    // crossings and dead ends become nodes; the runs of plain track between
+    // them become edges that list their cells. Trains walk an edge by index
+    // and only look at the map again when they reach a node.
+    //
+    // Edits only mark cells dirty. Sync() drops the edges and nodes that
+    // touch a dirty cell and walks the track again from their endpoints, so
+    // the rest of the network keeps its ids.
+    //
+    // Connected components are kept in a union-find over the nodes. New
+    // edges only merge sets. Removing track can split a component, so the
+    // components around the removed pieces are relabelled from scratch by
+    // walking the graph, which leaves the rest of the network untouched.
+    class RailNetwork
+    {
+    public:
+        struct Node
+        {
+            int i, j;
+            unsigned char mask;
+            bool alive;
+            uint32_t version;   // bumped each time the id is reused
+
+            // Edge leaving the node in each direction, as edge * 2 + 1 when
+            // the edge is walked backwards, or -1
+            int exits[4];
+        };
+
+        struct Edge
+        {
+            int from, to;
+            bool alive;
+            uint32_t version;
+
+            // Cells from the start node to the end node, both included, and
+            // the direction of each step between them
+            std::vector<std::pair<int, int>> cells;
+            std::vector<unsigned char> dirs;
+
+            int Length() const { return (int)dirs.size(); }
+        };
+
+        RailNetwork();
+
+        void Reset(int width, int height);
+        // removedTrack tells that the cell lost some rail, which may split
+        // its component
+        void InvalidateCell(int i, int j, bool removedTrack = false);
+        void Sync(const ChunkedGrid<Cell>& grid);
+
+        // Cursor for a train standing on (i, j) that is about to move in dir.
+        // Fails when no track leaves the cell that way.
+        bool Locate(int i, int j, int dir, RailCursor& cursor) const;
+        bool IsValid(const RailCursor& cursor) const;
+        int Length(const RailCursor& cursor) const { return edges[cursor.edge].Length(); }
+
+        // Cell under the cursor and the direction of travel out of it. At the
+        // end of the edge this is the node reached and the arrival direction.
+        void CursorCell(const RailCursor& cursor, int& i, int& j, int& dir) const;
+
+        // Whether two rail cells are joined by track, as of the last Sync.
+        // False when either cell has no rail.
+        bool Connected(int i1, int j1, int i2, int j2) const;
+        int ComponentCount() const;
+
+        // Node on a cell, -1 for plain track or no rail
+        int NodeIdAt(int i, int j) const;
+
+        // Nodes and edges by id; dead ones stay in place with alive unset
+        int NodeSlots() const { return (int)nodes.size(); }
+        const Node& GetNode(int id) const { return nodes[id]; }
+        const Edge& GetEdge(int id) const { return edges[id]; }
+
+        // Node at the other end of the edge leaving node through exit dir
+        int Neighbour(int node, int dir) const;
+
+        // Nodes created, removed, or that gained or lost an edge since the
+        // last ClearChanges(), possibly repeated. Everything else kept its
+        // edges, so results cached per node only need repairing around these.
+        const std::vector<int>& ChangedNodes() const { return changedNodes; }
+        void ClearChanges() { changedNodes.clear(); }
+
+        int NodeCount() const { return (int)nodes.size() - (int)freeNodes.size(); }
+        int EdgeCount() const { return (int)edges.size() - (int)freeEdges.size(); }
+        int LastRebuiltEdges() const { return lastRebuiltEdges; }
+
+    private:
+        struct CellLink
+        {
+            int node = -1;
+            int edge = -1;
+            int offset = 0;
+
+            bool operator==(const CellLink& other) const
+            {
+                return node == other.node && edge == other.edge && offset == other.offset;
+            }
+        };
+
+        static bool IsNodeCell(const Cell& cell)
+        {
+            return cell.RailMask() != 0 && (cell.HasStation() || CountBits(cell.RailMask()) != 2);
+        }
+
+        int EnsureNode(const ChunkedGrid<Cell>& grid, int i, int j);
+        void KillNode(int node);
+        void KillEdge(int edge);
+        void WalkEdge(const ChunkedGrid<Cell>& grid, int node, int dir);
+        void CoverCell(const ChunkedGrid<Cell>& grid, int i, int j);
+
+        // ===== CONNECTIVITY =====
+        int NodeAt(int i, int j) const;
+        int NewSet();
+        int FindSet(int set) const;
+        void UnionNodes(int a, int b);
+        void SplitComponents();
+        void LabelComponent(int start);
+
+        ChunkedGrid<CellLink> links;
+        std::vector<Node> nodes;
+        std::vector<Edge> edges;
+        std::vector<int> freeNodes;
+        std::vector<int> freeEdges;
+
+        std::vector<std::pair<int, int>> dirtyCells;
+        std::vector<std::pair<int, int>> seeds;
+        std::vector<int> pendingNodes;
+
+        int lastRebuiltEdges;
+        std::vector<int> changedNodes;
+
+        // Union-find elements are never reused: a node that is rebuilt or
+        // relabelled gets a fresh one, so other nodes still pointing at its
+        // old element keep a valid chain
+        std::vector<int> nodeSet;
+        std::vector<int> setParent;
+        std::vector<int> setSize;
+        bool splitPending;
+
+        std::vector<uint32_t> visited;
+        uint32_t visitStamp;
+        std::vector<int> walkQueue;
+    };
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+
+namespace m1
+{
+    // PCG32 generator (pcg-random.org). Unlike rand() every generator owns
+    // its state, and generators with the same seed but different stream ids
+    // give unrelated sequences, so each consumer can have its own stream.
+    // Parallel work should take a stream per work item rather than per
+    // thread, so the result does not depend on the thread count.
+    class Random
+    {
+    public:
+        Random() { Seed(0, 0); }
+        Random(uint64_t seed, uint64_t stream) { Seed(seed, stream); }
+
+        void Seed(uint64_t seed, uint64_t stream)
+        {
+            state = 0;
+            increment = (stream << 1) | 1;
+            Next();
+            state += seed;
+            Next();
+        }
+
+        uint32_t Next()
+        {
+            uint64_t old = state;
+            state = old * 6364136223846793005ULL + increment;
+            uint32_t shifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+            uint32_t rotation = (uint32_t)(old >> 59);
+            return (shifted >> rotation) | (shifted << ((32 - rotation) & 31));
+        }
+
+        // Uniform in [0, bound), for bound > 0
+        int Below(int bound)
+        {
+            return (int)(((uint64_t)Next() * (uint32_t)bound) >> 32);
+        }
+
+        // Uniform in [0, 1)
+        float Unit()
+        {
+            return (Next() >> 8) * (1.0f / 16777216.0f);
+        }
+
+        // Raw state, to save a generator and carry on where it left off
+        uint64_t State() const { return state; }
+        uint64_t Increment() const { return increment; }
+
+        void Restore(uint64_t savedState, uint64_t savedIncrement)
+        {
+            state = savedState;
+            increment = savedIncrement | 1;
+        }
+
+    private:
+        uint64_t state;
+        uint64_t increment;
+    };
+}
@@ -0,0 +1,61 @@
+#include "lab_m1/tema2/sim/route_cache.h"
+
+using namespace std;
+using namespace m1;
+
+
+void RouteCache::Reset()
+{
+    for (DistanceField& field : stationFields) field.Clear();
+    for (DistanceField& field : shapeFields) field.Clear();
+}
+
+void RouteCache::Update(const RailNetwork& network, const StationStore& stations,
+    const StationAt& stationAt)
+{
+    for (int id = 0; id < (int)stationFields.size(); id++) {
+        if (stationFields[id].Empty()) continue;
+        stationFields[id].Repair(network, [&](int node) { return stationAt(node) == id; });
+    }
+
+    for (int shape = 0; shape < SHAPE_COUNT; shape++) {
+        auto isSource = [&](int node) {
+            int station = stationAt(node);
+            return station >= 0 && (int)stations.shape[station] == shape;
+        };
+
+        if (shapeFields[shape].Empty()) shapeFields[shape].Build(network, isSource);
+        else shapeFields[shape].Repair(network, isSource);
+    }
+}
+
+void RouteCache::Prepare(const RailNetwork& network, int station, const StationAt& stationAt)
+{
+    if ((int)stationFields.size() <= station) stationFields.resize(station + 1);
+    if (!stationFields[station].Empty()) return;
+
+    stationFields[station].Build(network, [&](int node) { return stationAt(node) == station; });
+}
+
+void RouteCache::Retain(const std::vector<unsigned char>& keep)
+{
+    for (int id = 0; id < (int)stationFields.size(); id++)
+        if (id >= (int)keep.size() || !keep[id]) stationFields[id].Clear();
+}
+
+int RouteCache::Distance(int station, int node) const
+{
+    if (station < 0 || station >= (int)stationFields.size()) return -1;
+    return stationFields[station].Distance(node);
+}
+
+int RouteCache::StationExit(const RailNetwork& network, int station, int node, int excludedDir) const
+{
+    if (station < 0 || station >= (int)stationFields.size()) return -1;
+    return stationFields[station].NextExit(network, node, excludedDir);
+}
+
+int RouteCache::ShapeExit(const RailNetwork& network, StationShape shape, int node, int excludedDir) const
+{
+    return shapeFields[(int)shape].NextExit(network, node, excludedDir);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "lab_m1/tema2/sim/distance_field.h"
+#include "lab_m1/tema2/sim/rail_network.h"
+#include "lab_m1/tema2/sim/sim_types.h"
+#include "lab_m1/tema2/sim/station_store.h"
+
+
+namespace m1
+{
+    // Shortest routes over the rail network as distance fields: one per
+    // station, built the first time a train heads there, and one per shape
+    // towards the nearest station of that shape. Rail edits repair the
+    // fields in place, so moving trains only look up where to turn and
+    // never search. Station fields no train heads for any more are dropped
+    // with Retain() rather than repaired.
+    //
+    // Prepare() and Update() write and must run on one thread; the lookups
+    // only read and are safe from the parallel train update.
+    class RouteCache
+    {
+    public:
+        // Station on a network node, -1 for none
+        typedef std::function<int(int node)> StationAt;
+
+        void Reset();
+
+        // Repairs every field after the network changed, and builds the
+        // shape fields on first use
+        void Update(const RailNetwork& network, const StationStore& stations, const StationAt& stationAt);
+
+        void Prepare(const RailNetwork& network, int station, const StationAt& stationAt);
+
+        // Drops the station fields not marked in keep
+        void Retain(const std::vector<unsigned char>& keep);
+
+        // Cells from node to the station, -1 when unreachable or not prepared
+        int Distance(int station, int node) const;
+
+        // Exit of node that starts a shortest route to the station, or to
+        // the nearest station of a shape; never the excluded direction.
+        // -1 when there is none or node is already there.
+        int StationExit(const RailNetwork& network, int station, int node, int excludedDir) const;
+        int ShapeExit(const RailNetwork& network, StationShape shape, int node, int excludedDir) const;
+
+    private:
+        std::vector<DistanceField> stationFields;
+        DistanceField shapeFields[SHAPE_COUNT];
+    };
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+
+namespace m1
+{
+    // ===== GRID =====
+    enum class CellType {
+        Grass,
+        Water,
+        Mountain
+    };
+
+    enum class RailVisualType {
+        Normal,
+        Bridge,
+        Tunnel
+    };
+
+    enum RailDir {
+        NONE = 0,
+        UP = 1 << 0,
+        DOWN = 1 << 1,
+        LEFT = 1 << 2,
+        RIGHT = 1 << 3
+    };
+
+    // Layout of a packed cell byte
+    enum CellBits {
+        CELL_TYPE_MASK = 0x03,
+        CELL_RAIL_SHIFT = 2,
+        CELL_RAIL_MASK = 0x0F << CELL_RAIL_SHIFT,
+        CELL_STATION = 1 << 6
+    };
+
+    // One byte per cell: terrain type, rail directions and the station flag.
+    // Bridges and tunnels are rails over water and mountains, so they are not
+    // stored. Empty grass is the zero byte, which lets queries over whole
+    // rows test eight cells per 64-bit word (see cell_board.h).
+    struct Cell {
+        unsigned char bits = 0;
+
+        CellType Type() const { return (CellType)(bits & CELL_TYPE_MASK); }
+        unsigned char RailMask() const { return (bits & CELL_RAIL_MASK) >> CELL_RAIL_SHIFT; }
+        bool HasStation() const { return (bits & CELL_STATION) != 0; }
+
+        RailVisualType RailType() const
+        {
+            if (Type() == CellType::Water) return RailVisualType::Bridge;
+            if (Type() == CellType::Mountain) return RailVisualType::Tunnel;
+            return RailVisualType::Normal;
+        }
+
+        void SetType(CellType type)
+        {
+            bits = (unsigned char)((bits & ~CELL_TYPE_MASK) | (int)type);
+        }
+
+        void SetRailMask(unsigned char mask)
+        {
+            bits = (unsigned char)((bits & ~CELL_RAIL_MASK) | ((mask << CELL_RAIL_SHIFT) & CELL_RAIL_MASK));
+        }
+
+        void SetStation(bool station)
+        {
+            bits = (unsigned char)(station ? bits | CELL_STATION : bits & ~CELL_STATION);
+        }
+
+        bool operator==(const Cell& other) const { return bits == other.bits; }
+    };
+
+    static_assert(sizeof(Cell) == 1, "cells are packed in one byte");
+
+    // ===== GAME DATA =====
+    enum class StationShape {
+        Circle,
+        Square,
+        Pyramid
+    };
+
+    const int SHAPE_COUNT = 3;
+
+    // Passengers only differ by the shape of the station they travel to, so
+    // stations and trains keep a count per shape instead of a list. Whether
+    // to stop and how many get off are then a lookup, however many ride.
+    struct PassengerCounts {
+        int byShape[SHAPE_COUNT] = {};
+        int total = 0;
+
+        int Of(StationShape shape) const { return byShape[(int)shape]; }
+        bool Empty() const { return total == 0; }
+
+        void Add(StationShape shape, int count = 1)
+        {
+            byShape[(int)shape] += count;
+            total += count;
+        }
+
+        void Remove(StationShape shape, int count = 1)
+        {
+            byShape[(int)shape] -= count;
+            total -= count;
+        }
+
+        // Shape with the most passengers, the first one on ties
+        StationShape Largest() const
+        {
+            int best = 0;
+            for (int s = 1; s < SHAPE_COUNT; s++)
+                if (byShape[s] > byShape[best]) best = s;
+            return (StationShape)best;
+        }
+    };
+
+    // Position of a train on the compiled rail network: a run of track
+    // walked forwards or backwards, and how many cells along it the train is.
+    // The version tells whether the run was rebuilt since.
+    struct RailCursor
+    {
+        int edge = -1;
+        unsigned int version = 0;
+        bool reversed = false;
+        int offset = 0;
+    };
+
+    // ===== PLAYER ACTIONS =====
+    // One player input, as recorded by ActionLog and run by TrainSim::Perform.
+    // Only the fields of its kind are used; the rest stay zero so recordings
+    // compare byte for byte.
+    enum class PlayerActionKind : int32_t {
+        ConnectStation,     // select or connect the station at (x, z)
+        AddWagon,           // to train (slot, generation)
+        PlaceTrain,         // on cell (i, j)
+        EraseRails,         // through cell (i, j)
+        Restart
+    };
+
+    struct PlayerAction
+    {
+        uint64_t tick = 0;              // ticks run before it
+        PlayerActionKind kind = PlayerActionKind::Restart;
+        int32_t i = 0, j = 0;
+        float x = 0.0f, z = 0.0f;
+        uint32_t slot = 0, generation = 0;
+        uint32_t padding = 0;
+
+        static PlayerAction ConnectStation(const glm::vec3& hit)
+        {
+            PlayerAction action;
+            action.kind = PlayerActionKind::ConnectStation;
+            action.x = hit.x;
+            action.z = hit.z;
+            return action;
+        }
+
+        static PlayerAction AddWagon(uint32_t slot, uint32_t generation)
+        {
+            PlayerAction action;
+            action.kind = PlayerActionKind::AddWagon;
+            action.slot = slot;
+            action.generation = generation;
+            return action;
+        }
+
+        static PlayerAction AtCell(PlayerActionKind kind, int i, int j)
+        {
+            PlayerAction action;
+            action.kind = kind;
+            action.i = i;
+            action.j = j;
+            return action;
+        }
+
+        static PlayerAction Restart() { return PlayerAction(); }
+    };
+
+    // ===== DIRECTION HELPERS =====
+    // Direction indices are 0 = up, 1 = right, 2 = down, 3 = left.
+    inline bool AreOppositeDirs(int dir1, int dir2)
+    {
+        return (dir1 == 0 && dir2 == 2) || (dir1 == 2 && dir2 == 0) ||
+            (dir1 == 1 && dir2 == 3) || (dir1 == 3 && dir2 == 1);
+    }
+
+    inline int OppositeDir(int d)
+    {
+        return (d + 2) % 4;
+    }
+
+    inline int DirToMask(int d)
+    {
+        if (d == 0) return UP;
+        if (d == 1) return RIGHT;
+        if (d == 2) return DOWN;
+        return LEFT;
+    }
+
+    inline int CountBits(unsigned char mask)
+    {
+        int count = 0;
+        for (int i = 0; i < 4; i++) {
+            if (mask & (1 << i)) count++;
+        }
+        return count;
+    }
+}
@@ -0,0 +1,250 @@
+#include "lab_m1/tema2/sim/snapshot.h"
+
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+using namespace std;
+using namespace m1;
+
+
+namespace
+{
+    const char MAGIC[8] = { 'T', 'R', 'A', 'I', 'N', 'S', 'N', 'P' };
+
+    // Sections start on cache lines, which also covers every record type
+    const uint64_t SECTION_ALIGN = 64;
+
+    uint64_t AlignUp(uint64_t offset)
+    {
+        return (offset + SECTION_ALIGN - 1) & ~(SECTION_ALIGN - 1);
+    }
+}
+
+
+/* =========================================================
+ *  Writer
+ * ========================================================= */
+void SnapshotWriter::Add(uint32_t id, uint32_t recordSize, const void* records, size_t count)
+{
+    Section* section = nullptr;
+    for (Section& s : sections)
+        if (s.id == id) section = &s;
+
+    if (!section) {
+        sections.push_back(Section());
+        section = &sections.back();
+        section->id = id;
+        section->recordSize = recordSize;
+    }
+
+    if (count > 0) section->pieces.push_back({ records, count });
+}
+
+bool SnapshotWriter::Write(const std::string& path, uint32_t version) const
+{
+    std::vector<SnapshotSection> table(sections.size());
+    uint64_t offset = sizeof(SnapshotHeader) + table.size() * sizeof(SnapshotSection);
+
+    for (size_t k = 0; k < sections.size(); k++) {
+        uint64_t count = 0;
+        for (const Piece& piece : sections[k].pieces) count += piece.count;
+
+        offset = AlignUp(offset);
+        table[k].id = sections[k].id;
+        table[k].recordSize = sections[k].recordSize;
+        table[k].count = count;
+        table[k].offset = offset;
+        offset += count * sections[k].recordSize;
+    }
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = version;
+    header.sectionCount = (uint32_t)table.size();
+    header.fileSize = offset;
+
+    // Written next to the target and renamed over it, so a failed save never
+    // destroys the previous snapshot
+    std::string temp = path + ".tmp";
+    FILE* file = std::fopen(temp.c_str(), "wb");
+    if (!file) return false;
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    if (!table.empty())
+        ok = ok && std::fwrite(table.data(), sizeof(SnapshotSection), table.size(), file) == table.size();
+
+    static const unsigned char zeros[SECTION_ALIGN] = {};
+    uint64_t written = sizeof(SnapshotHeader) + table.size() * sizeof(SnapshotSection);
+    for (size_t k = 0; k < sections.size() && ok; k++) {
+        ok = std::fwrite(zeros, 1, (size_t)(table[k].offset - written), file) == table[k].offset - written;
+        written = table[k].offset;
+
+        for (const Piece& piece : sections[k].pieces) {
+            size_t bytes = piece.count * sections[k].recordSize;
+            ok = ok && std::fwrite(piece.data, 1, bytes, file) == bytes;
+            written += bytes;
+        }
+    }
+
+    ok = std::fclose(file) == 0 && ok;
+    if (ok) {
+#if defined(_WIN32)
+        ok = MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        ok = std::rename(temp.c_str(), path.c_str()) == 0;
+#endif
+    }
+    if (!ok) std::remove(temp.c_str());
+    return ok;
+}
+
+uint64_t SnapshotWriter::Hash() const
+{
+    uint64_t hash = 1469598103934665603ULL;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t k = 0; k < size; k++) {
+            hash ^= bytes[k];
+            hash *= 1099511628211ULL;
+        }
+    };
+
+    for (const Section& section : sections) {
+        uint64_t count = 0;
+        for (const Piece& piece : section.pieces) count += piece.count;
+
+        mix(&section.id, sizeof(section.id));
+        mix(&section.recordSize, sizeof(section.recordSize));
+        mix(&count, sizeof(count));
+        for (const Piece& piece : section.pieces)
+            mix(piece.data, piece.count * section.recordSize);
+    }
+    return hash;
+}
+
+/* =========================================================
+ *  Reader
+ * ========================================================= */
+SnapshotReader::SnapshotReader()
+{
+    data = nullptr;
+    size = 0;
+    sections = nullptr;
+    sectionCount = 0;
+#if defined(_WIN32)
+    file = INVALID_HANDLE_VALUE;
+    mapping = nullptr;
+#endif
+}
+
+SnapshotReader::~SnapshotReader()
+{
+    Close();
+}
+
+bool SnapshotReader::Open(const std::string& path, uint32_t version)
+{
+    Close();
+
+#if defined(_WIN32)
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(SnapshotHeader)) {
+        Close();
+        return false;
+    }
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        Close();
+        return false;
+    }
+    data = (const unsigned char*)view;
+    size = (size_t)fileSize.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(SnapshotHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    void* view = ::mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) return false;
+
+    data = (const unsigned char*)view;
+    size = (size_t)info.st_size;
+#endif
+
+    // Everything the section table points at must lie inside the file
+    const SnapshotHeader* header = (const SnapshotHeader*)data;
+    uint64_t tableEnd = sizeof(SnapshotHeader) + (uint64_t)header->sectionCount * sizeof(SnapshotSection);
+    bool valid = std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+        header->version == version && header->fileSize == size && tableEnd <= size;
+
+    const SnapshotSection* table = (const SnapshotSection*)(data + sizeof(SnapshotHeader));
+    for (uint32_t k = 0; valid && k < header->sectionCount; k++) {
+        const SnapshotSection& s = table[k];
+        valid = s.recordSize > 0 && s.offset % SECTION_ALIGN == 0 && s.offset <= size &&
+            s.count <= (size - s.offset) / s.recordSize;
+    }
+
+    if (!valid) {
+        Close();
+        return false;
+    }
+
+    sections = table;
+    sectionCount = header->sectionCount;
+    return true;
+}
+
+void SnapshotReader::Close()
+{
+#if defined(_WIN32)
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (data) ::munmap((void*)data, size);
+#endif
+
+    data = nullptr;
+    size = 0;
+    sections = nullptr;
+    sectionCount = 0;
+}
+
+bool SnapshotReader::Find(uint32_t id, uint32_t recordSize, const void*& records, size_t& count) const
+{
+    for (uint32_t k = 0; k < sectionCount; k++) {
+        if (sections[k].id != id) continue;
+        if (sections[k].recordSize != recordSize) return false;
+
+        records = data + sections[k].offset;
+        count = (size_t)sections[k].count;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace m1
+{
+    // Binary snapshot container: a header, a table of sections, then the
+    // sections themselves. A section is a flat array of fixed-size records,
+    // written in memory order and aligned, so a reader can map the file and
+    // use every section in place, or copy it out with one memcpy. Records
+    // are stored little-endian, like the machines the game runs on.
+    //
+    // The container knows nothing about the game; callers number their
+    // sections and bump the version whenever a record layout changes.
+    struct SnapshotHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t sectionCount;
+        uint64_t fileSize;
+    };
+
+    struct SnapshotSection
+    {
+        uint32_t id;
+        uint32_t recordSize;
+        uint64_t count;
+        uint64_t offset;        // from the start of the file
+    };
+
+    class SnapshotWriter
+    {
+    public:
+        // Appends records to a section, which may be added in several
+        // pieces. Only the pointer is kept: the data must stay alive and
+        // unchanged until Write returns.
+        void Add(uint32_t id, uint32_t recordSize, const void* records, size_t count);
+
+        template <typename T>
+        void Add(uint32_t id, const T* records, size_t count) { Add(id, (uint32_t)sizeof(T), records, count); }
+
+        template <typename T>
+        void Add(uint32_t id, const std::vector<T>& records) { Add(id, records.data(), records.size()); }
+
+        bool Write(const std::string& path, uint32_t version) const;
+
+        // FNV-1a over the sections and the records Write would store,
+        // leaving out the header and the alignment padding
+        uint64_t Hash() const;
+
+    private:
+        struct Piece
+        {
+            const void* data;
+            size_t count;
+        };
+
+        struct Section
+        {
+            uint32_t id;
+            uint32_t recordSize;
+            std::vector<Piece> pieces;
+        };
+
+        std::vector<Section> sections;
+    };
+
+    // Read-only view of a snapshot file, mapped into memory rather than read
+    class SnapshotReader
+    {
+    public:
+        SnapshotReader();
+        ~SnapshotReader();
+
+        // False when the file cannot be mapped or is not a snapshot of this
+        // version; the reader is then empty
+        bool Open(const std::string& path, uint32_t version);
+        void Close();
+
+        // Records of a section in place. False when the section is missing
+        // or its records have another size.
+        bool Find(uint32_t id, uint32_t recordSize, const void*& records, size_t& count) const;
+
+        template <typename T>
+        bool Find(uint32_t id, const T*& records, size_t& count) const
+        {
+            const void* data;
+            if (!Find(id, (uint32_t)sizeof(T), data, count)) return false;
+            records = (const T*)data;
+            return true;
+        }
+
+    private:
+        SnapshotReader(const SnapshotReader&);
+        SnapshotReader& operator=(const SnapshotReader&);
+
+        const unsigned char* data;
+        size_t size;
+        const SnapshotSection* sections;
+        uint32_t sectionCount;
+
+#if defined(_WIN32)
+        void* file;
+        void* mapping;
+#endif
+    };
+}
@@ -0,0 +1,89 @@
+#include "lab_m1/tema2/sim/station_sites.h"
+
+#include "lab_m1/tema2/sim/cell_board.h"
+
+using namespace std;
+using namespace m1;
+
+
+StationSites::StationSites()
+{
+    treeStep = count = 0;
+}
+
+void StationSites::Build(const ChunkedGrid<Cell>& grid)
+{
+    int width = grid.Width();
+    int height = grid.Height();
+    sites.Assign(width, height);
+
+    // Board bits of the first and last column, which are never sites
+    int words = sites.WordsPerRow();
+    std::vector<uint64_t> interior(words, ~0ULL);
+    interior[0] &= ~1ULL;
+    interior[(width - 1) / BitPlane::WORD_BITS] &= ~(1ULL << ((width - 1) % BitPlane::WORD_BITS));
+
+    for (int i = 1; i < height - 1; i++) {
+        uint64_t* row = sites.Row(i);
+        for (int c = 0; c < words; c++)
+            row[c] = FreeLandCells(grid, i, c) & interior[c];
+    }
+
+    // Linear-time Fenwick build: every node passes its sum to its parent
+    int total = words * height;
+    tree.assign(total + 1, 0);
+    count = 0;
+    for (int k = 1; k <= total; k++) {
+        int bits = PopCount(sites.Data()[k - 1]);
+        count += bits;
+        tree[k] += bits;
+        int parent = k + (k & -k);
+        if (parent <= total) tree[parent] += tree[k];
+    }
+
+    treeStep = 1;
+    while (treeStep * 2 <= total) treeStep *= 2;
+}
+
+void StationSites::Exclude(int i, int j)
+{
+    for (int ni = std::max(i - 1, 0); ni <= std::min(i + 1, sites.Height() - 1); ni++) {
+        for (int nj = std::max(j - 1, 0); nj <= std::min(j + 1, sites.Width() - 1); nj++) {
+            if (!sites.Get(ni, nj)) continue;
+
+            sites.Row(ni)[nj / BitPlane::WORD_BITS] &= ~(1ULL << (nj % BitPlane::WORD_BITS));
+            AddToWord(ni * sites.WordsPerRow() + nj / BitPlane::WORD_BITS, -1);
+            count--;
+        }
+    }
+}
+
+bool StationSites::Sample(Random& random, int& i, int& j) const
+{
+    if (count == 0) return false;
+
+    // Find the word holding the site of rank r, then the bit inside it
+    int r = random.Below(count);
+    int word = 0;
+    int total = (int)tree.size() - 1;
+    for (int step = treeStep; step > 0; step >>= 1) {
+        if (word + step <= total && tree[word + step] <= r) {
+            word += step;
+            r -= tree[word];
+        }
+    }
+
+    uint64_t bits = sites.Data()[word];
+    for (; r > 0; r--) bits &= bits - 1;
+
+    i = word / sites.WordsPerRow();
+    j = (word % sites.WordsPerRow()) * BitPlane::WORD_BITS + LowestBit(bits);
+    return true;
+}
+
+void StationSites::AddToWord(int word, int delta)
+{
+    int total = (int)tree.size() - 1;
+    for (int k = word + 1; k <= total; k += k & -k)
+        tree[k] += delta;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "lab_m1/tema2/sim/bit_plane.h"
+#include "lab_m1/tema2/sim/chunked_grid.h"
+#include "lab_m1/tema2/sim/random.h"
+#include "lab_m1/tema2/sim/sim_types.h"
+
+
+namespace m1
+{
+    // Cells a new station may be placed on: free grass off the map border,
+    // with no station in its 3x3 neighbourhood. Sites are one bit per cell,
+    // plus a Fenwick tree of the site count per 64-bit word, so a uniformly
+    // random site takes a single draw and a descent of the tree, however
+    // full the map is, and adding a station only touches its 3x3 block.
+    class StationSites
+    {
+    public:
+        StationSites();
+
+        // Every free grass cell of the grid, which must not hold stations yet
+        void Build(const ChunkedGrid<Cell>& grid);
+
+        // Removes the sites too close to a new station at (i, j)
+        void Exclude(int i, int j);
+
+        bool Contains(int i, int j) const { return sites.Get(i, j); }
+        int Count() const { return count; }
+
+        // False when no site is left
+        bool Sample(Random& random, int& i, int& j) const;
+
+    private:
+        void AddToWord(int word, int delta);
+
+        BitPlane sites;
+        std::vector<int> tree;  // 1-based, over words in row-major order
+        int treeStep;           // largest power of two not above the word count
+        int count;
+    };
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "lab_m1/tema2/sim/sim_types.h"
+
+
+namespace m1
+{
+    // Stations stored as one array per field, like TrainStore, indexed by
+    // station id. Stations are never removed, so an id stays valid until the
+    // game restarts. Passenger spawning and train stops walk the shapes and
+    // waiting counts; positions are only needed for picking and drawing.
+    class StationStore
+    {
+    public:
+        int Count() const { return (int)shape.size(); }
+        bool Empty() const { return shape.empty(); }
+
+        // Id of the new station, with no one waiting yet
+        int Add(const glm::vec3& stationPos, StationShape stationShape)
+        {
+            shape.push_back(stationShape);
+            waiting.push_back(PassengerCounts());
+            fullToken.push_back(0);
+            pos.push_back(stationPos);
+            return Count() - 1;
+        }
+
+        void Clear()
+        {
+            shape.clear();
+            waiting.clear();
+            fullToken.clear();
+            pos.clear();
+        }
+
+        // ===== HOT =====
+        std::vector<StationShape> shape;
+        std::vector<PassengerCounts> waiting;
+
+        // Bumped whenever the station stops being full, which cancels the
+        // game over scheduled when it filled up
+        std::vector<uint32_t> fullToken;
+
+        // ===== COLD =====
+        std::vector<glm::vec3> pos;
+    };
+}
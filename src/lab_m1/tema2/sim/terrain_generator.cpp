@@ -0,0 +1,317 @@
+#include "lab_m1/tema2/sim/terrain_generator.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The game links its own copy of stb_image, so keep this one private
+#if defined(_MSC_VER)
+#   pragma warning(push, 0)
+#elif defined(__GNUC__)
+#   pragma GCC diagnostic push
+#   pragma GCC diagnostic ignored "-Wunused-function"
+#   pragma GCC diagnostic ignored "-Wunused-but-set-variable"
+#endif
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb/stb_image.h"
+#if defined(_MSC_VER)
+#   pragma warning(pop)
+#elif defined(__GNUC__)
+#   pragma GCC diagnostic pop
+#endif
+
+using namespace std;
+using namespace m1;
+
+
+namespace
+{
+    const int ROWS_PER_JOB = 64;
+
+    float LatticeValue(uint32_t x, uint32_t y, uint32_t seed)
+    {
+        uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+        h ^= h >> 15;
+        h *= 0x2c1b3c6du;
+        h ^= h >> 12;
+        h *= 0x297a2d39u;
+        h ^= h >> 15;
+        return (h >> 8) * (1.0f / 16777216.0f);
+    }
+
+    float Smooth(float t)
+    {
+        return t * t * (3.0f - 2.0f * t);
+    }
+
+    // Lattice values of one octave along the two lattice rows around the
+    // current cell row. Rows are visited in order, so they only need
+    // hashing again once the cell row crosses into the next lattice row.
+    struct OctaveRows
+    {
+        uint32_t y0 = UINT32_MAX;
+        std::vector<float> top, bottom;
+    };
+
+    // Adds one octave of value noise with the given period, in cells, to a
+    // row. Lattice values are blended vertically once per lattice column;
+    // the cells between two columns then only need a smoothed lerp.
+    void AddNoiseRow(float* row, int width, int i, float period, float amplitude, uint32_t seed,
+        OctaveRows& lattice)
+    {
+        float fy = i / period;
+        uint32_t y0 = (uint32_t)fy;
+        float ty = Smooth(fy - y0);
+
+        uint32_t columns = (uint32_t)(width / period) + 2;
+        if (lattice.y0 != y0) {
+            lattice.y0 = y0;
+            lattice.top.resize(columns);
+            lattice.bottom.resize(columns);
+            for (uint32_t x = 0; x < columns; x++) {
+                lattice.top[x] = LatticeValue(x, y0, seed);
+                lattice.bottom[x] = LatticeValue(x, y0 + 1, seed);
+            }
+        }
+
+        float left = 0.0f;
+        for (uint32_t x = 0; x < columns; x++) {
+            float top = lattice.top[x];
+            float bottom = lattice.bottom[x];
+            float right = top + (bottom - top) * ty;
+
+            if (x > 0) {
+                int j0 = (int)std::ceil((x - 1) * period);
+                int j1 = std::min((int)std::ceil(x * period), width);
+                float start = (x - 1) * period;
+                float step = 1.0f / period;
+                float delta = (right - left) * amplitude;
+                float base = left * amplitude;
+
+                for (int j = j0; j < j1; j++)
+                    row[j] += base + delta * Smooth((j - start) * step);
+            }
+            left = right;
+        }
+    }
+}
+
+
+struct TerrainGenerator::Scratch
+{
+    std::vector<float> heights, rivers, image;
+    std::vector<OctaveRows> octaves;
+    OctaveRows riverOctaves[2];
+};
+
+
+TerrainGenerator::TerrainGenerator()
+{
+    heightmapWidth = heightmapHeight = 0;
+}
+
+bool TerrainGenerator::Load(const TerrainSettings& terrainSettings)
+{
+    settings = terrainSettings;
+    heightmap.clear();
+    heightmapWidth = heightmapHeight = 0;
+
+    if (settings.heightmapPath.empty()) return true;
+
+    int w, h, channels;
+    unsigned char* pixels = stbi_load(settings.heightmapPath.c_str(), &w, &h, &channels, 1);
+    if (!pixels) return false;
+
+    heightmap.resize((size_t)w * h);
+    for (size_t k = 0; k < heightmap.size(); k++)
+        heightmap[k] = pixels[k] * (1.0f / 255.0f);
+    stbi_image_free(pixels);
+
+    heightmapWidth = w;
+    heightmapHeight = h;
+    return true;
+}
+
+void TerrainGenerator::Generate(ChunkedGrid<Cell>& grid, uint32_t seed, ThreadPool& pool) const
+{
+    int width = grid.Width();
+    int height = grid.Height();
+
+    BitPlane water, mountain;
+    water.Assign(width, height);
+    mountain.Assign(width, height);
+
+    pool.ParallelFor(height, ROWS_PER_JOB, [&](int begin, int end) {
+        Scratch scratch;
+        scratch.heights.resize(width);
+        scratch.rivers.resize(width);
+        scratch.image.resize(width);
+        scratch.octaves.resize(settings.octaves);
+
+        const std::vector<float>& heights = scratch.heights;
+        const std::vector<float>& rivers = scratch.rivers;
+
+        for (int i = begin; i < end; i++) {
+            HeightRow(i, width, height, seed, scratch);
+            RiverRow(i, width, height, seed, scratch);
+
+            uint64_t* waterRow = water.Row(i);
+            uint64_t* mountainRow = mountain.Row(i);
+            for (int j = 0; j < width; j++) {
+                uint64_t bit = 1ULL << (j % BitPlane::WORD_BITS);
+                if (heights[j] < settings.waterLevel) waterRow[j / BitPlane::WORD_BITS] |= bit;
+                else if (std::fabs(rivers[j] - 0.5f) < settings.riverWidth) waterRow[j / BitPlane::WORD_BITS] |= bit;
+                else if (heights[j] > settings.mountainLevel) mountainRow[j / BitPlane::WORD_BITS] |= bit;
+            }
+        }
+    });
+
+    SmoothMountains(water, mountain, pool);
+    WriteCells(grid, water, mountain, pool);
+}
+
+void TerrainGenerator::SmoothMountains(const BitPlane& water, BitPlane& mountain, ThreadPool& pool) const
+{
+    int width = mountain.Width();
+    int height = mountain.Height();
+    int words = mountain.WordsPerRow();
+    if (width < 3 || height < 3) return;
+
+    // Cells on the map border and water never change
+    std::vector<uint64_t> interior(words, ~0ULL);
+    interior[0] &= ~1ULL;
+    interior[(width - 1) / BitPlane::WORD_BITS] &= ~(1ULL << ((width - 1) % BitPlane::WORD_BITS));
+    if (width % BitPlane::WORD_BITS)
+        interior[words - 1] &= (1ULL << (width % BitPlane::WORD_BITS)) - 1;
+
+    // Double buffered, so every cell sees its neighbours from before the pass
+    BitPlane next;
+    next.Assign(width, height);
+
+    for (int pass = 0; pass < settings.smoothingPasses; pass++) {
+        std::copy(mountain.Row(0), mountain.Row(0) + words, next.Row(0));
+        std::copy(mountain.Row(height - 1), mountain.Row(height - 1) + words, next.Row(height - 1));
+
+        pool.ParallelFor(height - 2, ROWS_PER_JOB, [&](int begin, int end) {
+            for (int i = begin + 1; i <= end; i++) {
+                const uint64_t* up = mountain.Row(i - 1);
+                const uint64_t* row = mountain.Row(i);
+                const uint64_t* down = mountain.Row(i + 1);
+                const uint64_t* wet = water.Row(i);
+                uint64_t* out = next.Row(i);
+
+                for (int k = 0; k < words; k++) {
+                    uint64_t m = row[k];
+                    uint64_t left = (m << 1) | (k > 0 ? row[k - 1] >> 63 : 0);
+                    uint64_t right = (m >> 1) | (k + 1 < words ? row[k + 1] << 63 : 0);
+
+                    // Neighbour counts of 64 cells at once: any three of the
+                    // four include both vertical or both horizontal ones
+                    uint64_t vertical = up[k] & down[k];
+                    uint64_t horizontal = left & right;
+                    uint64_t anyVertical = up[k] | down[k];
+                    uint64_t anyHorizontal = left | right;
+                    uint64_t atLeastTwo = vertical | horizontal | (anyVertical & anyHorizontal);
+                    uint64_t atLeastThree = (vertical & anyHorizontal) | (horizontal & anyVertical);
+
+                    uint64_t land = interior[k] & ~wet[k];
+                    out[k] = (m & ~land) | (land & (atLeastThree | (m & atLeastTwo)));
+                }
+            }
+        });
+
+        mountain.Swap(next);
+    }
+}
+
+void TerrainGenerator::WriteCells(ChunkedGrid<Cell>& grid, const BitPlane& water, const BitPlane& mountain,
+    ThreadPool& pool) const
+{
+    // A chunk row is exactly one word, and a band of whole chunk rows never
+    // shares a chunk with another band
+    static_assert(ChunkedGrid<Cell>::CHUNK_SIZE == BitPlane::WORD_BITS, "chunk rows must match plane words");
+
+    pool.ParallelFor(grid.ChunksY(), 1, [&](int begin, int end) {
+        for (int band = begin; band < end; band++) {
+            for (int c = 0; c < grid.ChunksX(); c++) {
+                int i0, j0, i1, j1;
+                grid.ChunkCellRange(band, c, i0, j0, i1, j1);
+
+                for (int i = i0; i < i1; i++) {
+                    for (uint64_t bits = water.Row(i)[c]; bits; bits &= bits - 1)
+                        grid.Edit(i, j0 + LowestBit(bits)).SetType(CellType::Water);
+                    for (uint64_t bits = mountain.Row(i)[c]; bits; bits &= bits - 1)
+                        grid.Edit(i, j0 + LowestBit(bits)).SetType(CellType::Mountain);
+                }
+            }
+        }
+    });
+}
+
+float TerrainGenerator::BasePeriod(int width, int height) const
+{
+    return std::min(settings.featureSize, std::max(width, height) * 0.5f);
+}
+
+void TerrainGenerator::HeightRow(int i, int width, int height, uint32_t seed, Scratch& scratch) const
+{
+    std::vector<float>& row = scratch.heights;
+    std::fill(row.begin(), row.end(), 0.0f);
+
+    float period = BasePeriod(width, height);
+    float amplitude = 1.0f;
+    float total = 0.0f;
+    for (int octave = 0; octave < settings.octaves && period >= 1.0f; octave++) {
+        AddNoiseRow(row.data(), width, i, period, amplitude, seed + octave, scratch.octaves[octave]);
+        total += amplitude;
+        period *= 0.5f;
+        amplitude *= 0.5f;
+    }
+
+    float scale = total > 0.0f ? 1.0f / total : 0.0f;
+    for (int j = 0; j < width; j++)
+        row[j] *= scale;
+
+    if (heightmap.empty()) return;
+
+    std::vector<float>& image = scratch.image;
+    HeightmapRow(i, width, height, image);
+
+    float weight = settings.heightmapWeight;
+    for (int j = 0; j < width; j++)
+        row[j] += (image[j] - row[j]) * weight;
+}
+
+void TerrainGenerator::RiverRow(int i, int width, int height, uint32_t seed, Scratch& scratch) const
+{
+    std::vector<float>& row = scratch.rivers;
+    std::fill(row.begin(), row.end(), 0.0f);
+
+    float period = BasePeriod(width, height) * 2.0f;
+    AddNoiseRow(row.data(), width, i, period, 0.75f, seed ^ 0x52495645u, scratch.riverOctaves[0]);
+    AddNoiseRow(row.data(), width, i, period * 0.5f, 0.25f, seed ^ 0x52495646u, scratch.riverOctaves[1]);
+}
+
+void TerrainGenerator::HeightmapRow(int i, int width, int height, std::vector<float>& row) const
+{
+    // Bilinear sample of the image stretched over the map
+    float v = height > 1 ? i * (heightmapHeight - 1) / float(height - 1) : 0.0f;
+    int y0 = std::min((int)v, heightmapHeight - 1);
+    int y1 = std::min(y0 + 1, heightmapHeight - 1);
+    float ty = v - y0;
+
+    const float* top = &heightmap[(size_t)y0 * heightmapWidth];
+    const float* bottom = &heightmap[(size_t)y1 * heightmapWidth];
+
+    float scale = width > 1 ? (heightmapWidth - 1) / float(width - 1) : 0.0f;
+    for (int j = 0; j < width; j++) {
+        float u = j * scale;
+        int x0 = std::min((int)u, heightmapWidth - 1);
+        int x1 = std::min(x0 + 1, heightmapWidth - 1);
+        float tx = u - x0;
+
+        float a = top[x0] + (top[x1] - top[x0]) * tx;
+        float b = bottom[x0] + (bottom[x1] - bottom[x0]) * tx;
+        row[j] = a + (b - a) * ty;
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "lab_m1/tema2/sim/bit_plane.h"
+#include "lab_m1/tema2/sim/chunked_grid.h"
+#include "lab_m1/tema2/sim/sim_types.h"
+#include "lab_m1/tema2/sim/thread_pool.h"
+
+
+namespace m1
+{
+    // Shape of the generated terrain. Heights are in [0, 1].
+    struct TerrainSettings
+    {
+        // Optional grayscale image (PNG or JPG) blended into the noise and
+        // stretched over the whole map, e.g. assets/textures/heightmap.png.
+        // Empty for noise only.
+        std::string heightmapPath;
+        float heightmapWeight = 0.7f;
+
+        // Cells per period of the coarsest noise octave. Small maps use a
+        // shorter period so they still get some variety.
+        float featureSize = 32.0f;
+        int octaves = 4;
+
+        float waterLevel = 0.3f;        // lower heights are lakes
+        float mountainLevel = 0.66f;    // higher heights are mountains
+
+        // Rivers follow the middle contour of a separate, coarser noise;
+        // this is their half width in noise units
+        float riverWidth = 0.02f;
+
+        // Passes of the smoothing automaton run afterwards: land with three
+        // or more mountain neighbours becomes mountain, land with at most
+        // one becomes grass
+        int smoothingPasses = 1;
+    };
+
+    // Builds the map terrain from fractal value noise. Every cell only
+    // depends on its coordinates and the seed, so the map is generated in
+    // bands of rows in parallel, and is the same for any thread count.
+    // Noise rows are evaluated span by span between lattice points, which
+    // leaves the inner loops as plain arithmetic the compiler can vectorize.
+    //
+    // Water and mountains are first collected in bit planes, smoothed there
+    // 64 cells per word, and only then written to the grid, which never
+    // expands chunks that stay all grass.
+    class TerrainGenerator
+    {
+    public:
+        TerrainGenerator();
+
+        // Loads the heightmap named in the settings, if any. Returns false,
+        // and falls back to noise only, when it cannot be read.
+        bool Load(const TerrainSettings& settings);
+
+        // Sets the terrain type of every cell; the grid must be all grass
+        void Generate(ChunkedGrid<Cell>& grid, uint32_t seed, ThreadPool& pool) const;
+
+        bool HasHeightmap() const { return !heightmap.empty(); }
+
+    private:
+        // Per-thread buffers reused from row to row
+        struct Scratch;
+
+        float BasePeriod(int width, int height) const;
+        void HeightRow(int i, int width, int height, uint32_t seed, Scratch& scratch) const;
+        void RiverRow(int i, int width, int height, uint32_t seed, Scratch& scratch) const;
+        void HeightmapRow(int i, int width, int height, std::vector<float>& row) const;
+        void SmoothMountains(const BitPlane& water, BitPlane& mountain, ThreadPool& pool) const;
+        void WriteCells(ChunkedGrid<Cell>& grid, const BitPlane& water, const BitPlane& mountain,
+            ThreadPool& pool) const;
+
+        TerrainSettings settings;
+        std::vector<float> heightmap;
+        int heightmapWidth, heightmapHeight;
+    };
+}
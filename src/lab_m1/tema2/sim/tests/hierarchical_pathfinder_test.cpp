@@ -0,0 +1,138 @@
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include "lab_m1/tema2/sim/hierarchical_pathfinder.h"
+#include "lab_m1/tema2/sim/pathfinder.h"
+#include "lab_m1/tema2/sim/random.h"
+#include "lab_m1/tema2/sim/tests/test_check.h"
+
+using namespace m1;
+
+
+// HPA* paths against the flat A* on random terrain, before and after the
+// terrain under some clusters changes
+
+namespace
+{
+    const int SIZE = 6 * HierarchicalPathfinder::CLUSTER_SIZE;
+    const int QUERIES = 300;
+
+    // HPA* only plans through cluster borders, so its paths may cost a
+    // little more than the cheapest one
+    const float MAX_OVERHEAD = 1.25f;
+
+    // Existing track is priced so high it acts as a wall
+    const int BLOCKED_RAIL_COST = 100000;
+
+    // Inside one row of clusters, so only their stored costs know about it
+    const int BAND_ROW = 2 * HierarchicalPathfinder::CLUSTER_SIZE + 10;
+
+    void RandomGrid(Random& random, ChunkedGrid<Cell>& grid)
+    {
+        grid.Assign(SIZE, SIZE, Cell());
+        for (int i = 0; i < SIZE; i += 8) {
+            for (int j = 0; j < SIZE; j += 8) {
+                CellType type = (CellType)random.Below(3);
+                for (int di = 0; di < 8; di++) {
+                    for (int dj = 0; dj < 8; dj++) {
+                        Cell cell;
+                        cell.SetType(random.Below(8) == 0 ? (CellType)random.Below(3) : type);
+                        grid.Set(i + di, j + dj, cell);
+                    }
+                }
+            }
+        }
+    }
+
+    // Cost of the path, -1 when it is not one step at a time from start to
+    // target, visits a cell twice or runs over track between its ends
+    int PathCost(const ChunkedGrid<Cell>& grid, const PathCosts& costs,
+        const std::vector<std::pair<int, int>>& path, int si, int sj, int ti, int tj)
+    {
+        if (path.empty() || path.front() != std::make_pair(si, sj) || path.back() != std::make_pair(ti, tj))
+            return -1;
+
+        std::vector<unsigned char> seen(SIZE * SIZE, 0);
+        int cost = 0;
+        for (size_t k = 0; k < path.size(); k++) {
+            int i = path[k].first, j = path[k].second;
+            if (!grid.InBounds(i, j) || seen[i * SIZE + j]) return -1;
+            seen[i * SIZE + j] = 1;
+            if (k == 0) continue;
+
+            if (std::abs(i - path[k - 1].first) + std::abs(j - path[k - 1].second) != 1) return -1;
+            if (grid.At(i, j).RailMask() && k + 1 < path.size()) return -1;
+            cost += costs.For(grid.At(i, j));
+        }
+        return cost;
+    }
+
+    void CheckPaths(Random& random, const ChunkedGrid<Cell>& grid, HierarchicalPathfinder& hierarchical,
+        Pathfinder& flat, const char* validWhat, const char* boundWhat)
+    {
+        std::vector<std::pair<int, int>> path;
+        int valid = 0, bounded = 0;
+        for (int q = 0; q < QUERIES; q++) {
+            int si = random.Below(SIZE), sj = random.Below(SIZE);
+            int ti = random.Below(SIZE), tj = random.Below(SIZE);
+
+            if (grid.At(si, sj).RailMask() || grid.At(ti, tj).RailMask()) {
+                valid++;
+                bounded++;
+                continue;
+            }
+
+            if (!hierarchical.FindPath(grid, si, sj, ti, tj, path)) continue;
+            int cost = PathCost(grid, hierarchical.GetCosts(), path, si, sj, ti, tj);
+            if (cost < 0) continue;
+            valid++;
+
+            if (!flat.FindPath(grid, si, sj, ti, tj, path)) continue;
+            if (cost >= flat.LastCost() && cost <= flat.LastCost() * MAX_OVERHEAD) bounded++;
+        }
+
+        Check(valid == QUERIES, validWhat);
+        Check(bounded == QUERIES, boundWhat);
+    }
+
+    void MatchesFlatSearch()
+    {
+        Random random(11, 0);
+        ChunkedGrid<Cell> grid;
+        RandomGrid(random, grid);
+
+        PathCosts costs;
+        costs.rail = BLOCKED_RAIL_COST;
+
+        HierarchicalPathfinder hierarchical;
+        hierarchical.SetCosts(costs);
+        hierarchical.Reset(SIZE, SIZE);
+        Pathfinder flat;
+        flat.costs = costs;
+
+        CheckPaths(random, grid, hierarchical, flat,
+            "paths are contiguous and loop free", "path costs close to the flat search");
+
+        // Track laid across most of the map, which paths have to go around;
+        // the clusters under it have to be rebuilt
+        for (int j = 0; j < SIZE - 20; j++) {
+            for (int i = BAND_ROW; i < BAND_ROW + 4; i++) {
+                Cell cell = grid.At(i, j);
+                cell.SetRailMask(LEFT | RIGHT);
+                grid.Set(i, j, cell);
+                hierarchical.InvalidateCell(i, j);
+            }
+        }
+
+        CheckPaths(random, grid, hierarchical, flat,
+            "paths after an edit are contiguous and loop free", "path costs after an edit close to the flat search");
+    }
+}
+
+
+int main()
+{
+    MatchesFlatSearch();
+    return TestResult();
+}
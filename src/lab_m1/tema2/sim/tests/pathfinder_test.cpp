@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "lab_m1/tema2/sim/pathfinder.h"
+#include "lab_m1/tema2/sim/random.h"
+#include "lab_m1/tema2/sim/tests/test_check.h"
+
+using namespace m1;
+
+
+// Pathfinder against a plain Dijkstra and a heap-based A* on random terrain
+
+namespace
+{
+    const int SIZE = 80;
+    const int QUERIES = 400;
+
+    // Terrain in patches, so paths have to go around, with some track on top
+    void RandomGrid(Random& random, ChunkedGrid<Cell>& grid)
+    {
+        grid.Assign(SIZE, SIZE, Cell());
+        for (int i = 0; i < SIZE; i += 4) {
+            for (int j = 0; j < SIZE; j += 4) {
+                CellType type = (CellType)random.Below(3);
+                for (int di = 0; di < 4; di++) {
+                    for (int dj = 0; dj < 4; dj++) {
+                        Cell cell;
+                        cell.SetType(random.Below(6) == 0 ? (CellType)random.Below(3) : type);
+                        if (random.Below(10) == 0) cell.SetRailMask(UP | DOWN);
+                        grid.Set(i + di, j + dj, cell);
+                    }
+                }
+            }
+        }
+    }
+
+    // Cheapest cost from the start into (ti, tj) inside the rectangle, or -1
+    int ReferenceCost(const ChunkedGrid<Cell>& grid, const PathCosts& costs, int si, int sj, int ti, int tj,
+        int minI, int minJ, int maxI, int maxJ)
+    {
+        const int DI[4] = { -1, 0, 1, 0 };
+        const int DJ[4] = { 0, 1, 0, -1 };
+
+        std::vector<int> best(SIZE * SIZE, INT_MAX);
+        typedef std::pair<int, int> Entry;  // cost, cell
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+
+        best[si * SIZE + sj] = 0;
+        open.push({ 0, si * SIZE + sj });
+        while (!open.empty()) {
+            Entry cur = open.top();
+            open.pop();
+            if (cur.first > best[cur.second]) continue;
+
+            int i = cur.second / SIZE, j = cur.second % SIZE;
+            if (i == ti && j == tj) return cur.first;
+
+            for (int d = 0; d < 4; d++) {
+                int ni = i + DI[d], nj = j + DJ[d];
+                if (ni < minI || nj < minJ || ni > maxI || nj > maxJ) continue;
+
+                int g = cur.first + costs.For(grid.At(ni, nj));
+                if (g < best[ni * SIZE + nj]) {
+                    best[ni * SIZE + nj] = g;
+                    open.push({ g, ni * SIZE + nj });
+                }
+            }
+        }
+        return -1;
+    }
+
+    // The same A* over a binary heap, popping the latest push among equal f
+    // like the bucket stacks do. Returns the cells expanded, -1 for no path.
+    int ReferenceExpanded(const ChunkedGrid<Cell>& grid, const PathCosts& costs, int si, int sj, int ti, int tj,
+        int minI, int minJ, int maxI, int maxJ)
+    {
+        const int DI[4] = { -1, 0, 1, 0 };
+        const int DJ[4] = { 0, 1, 0, -1 };
+        const int hScale = costs.Min() * costs.heuristicWeight;
+
+        struct Entry
+        {
+            int f, sequence, g, cell;
+            bool operator<(const Entry& other) const
+            {
+                if (f != other.f) return f > other.f;
+                return sequence < other.sequence;
+            }
+        };
+
+        std::vector<int> g(SIZE * SIZE, INT_MAX);
+        std::vector<char> closed(SIZE * SIZE, 0);
+        std::priority_queue<Entry> open;
+        int sequence = 0, expanded = 0;
+
+        g[si * SIZE + sj] = 0;
+        open.push({ (std::abs(si - ti) + std::abs(sj - tj)) * hScale / 100, sequence++, 0, si * SIZE + sj });
+        while (!open.empty()) {
+            Entry cur = open.top();
+            open.pop();
+            if (closed[cur.cell] || g[cur.cell] != cur.g) continue;
+
+            closed[cur.cell] = 1;
+            expanded++;
+
+            int i = cur.cell / SIZE, j = cur.cell % SIZE;
+            if (i == ti && j == tj) return expanded;
+
+            for (int d = 0; d < 4; d++) {
+                int ni = i + DI[d], nj = j + DJ[d];
+                if (ni < minI || nj < minJ || ni > maxI || nj > maxJ) continue;
+
+                int next = ni * SIZE + nj;
+                int ng = cur.g + costs.For(grid.At(ni, nj));
+                if (closed[next] || ng >= g[next]) continue;
+
+                g[next] = ng;
+                int h = (std::abs(ni - ti) + std::abs(nj - tj)) * hScale / 100;
+                open.push({ ng + h, sequence++, ng, next });
+            }
+        }
+        return -1;
+    }
+
+    // Steps of one cell from start to target inside the rectangle, costing
+    // what LastCost says
+    bool ValidPath(const ChunkedGrid<Cell>& grid, const Pathfinder& finder,
+        const std::vector<std::pair<int, int>>& path, int si, int sj, int ti, int tj,
+        int minI, int minJ, int maxI, int maxJ)
+    {
+        if (path.empty() || path.front() != std::make_pair(si, sj) || path.back() != std::make_pair(ti, tj))
+            return false;
+
+        int cost = 0;
+        for (size_t k = 0; k < path.size(); k++) {
+            int i = path[k].first, j = path[k].second;
+            if (i < minI || j < minJ || i > maxI || j > maxJ) return false;
+            if (k == 0) continue;
+
+            if (std::abs(i - path[k - 1].first) + std::abs(j - path[k - 1].second) != 1) return false;
+            cost += finder.costs.For(grid.At(i, j));
+        }
+        return cost == finder.LastCost();
+    }
+
+    void MatchesDijkstra(int weight)
+    {
+        Random random(7, (uint64_t)weight);
+        ChunkedGrid<Cell> grid;
+        Pathfinder finder;
+        finder.costs.heuristicWeight = weight;
+        std::vector<std::pair<int, int>> path;
+
+        int optimal = 0, cheaper = 0, sameOrder = 0, valid = 0, missed = 0, found = 0;
+        for (int q = 0; q < QUERIES; q++) {
+            if (q % 50 == 0) RandomGrid(random, grid);
+
+            int si = random.Below(SIZE), sj = random.Below(SIZE);
+            int ti = random.Below(SIZE), tj = random.Below(SIZE);
+
+            // Every other query keeps to a rectangle around both ends
+            int minI = 0, minJ = 0, maxI = SIZE - 1, maxJ = SIZE - 1;
+            if (q % 2) {
+                minI = std::max(std::min(si, ti) - 3, 0);
+                minJ = std::max(std::min(sj, tj) - 3, 0);
+                maxI = std::min(std::max(si, ti) + 3, SIZE - 1);
+                maxJ = std::min(std::max(sj, tj) + 3, SIZE - 1);
+            }
+
+            int reference = ReferenceCost(grid, finder.costs, si, sj, ti, tj, minI, minJ, maxI, maxJ);
+            if (!finder.FindPath(grid, si, sj, ti, tj, minI, minJ, maxI, maxJ, path)) {
+                if (reference >= 0) missed++;
+                continue;
+            }
+
+            found++;
+            if (ValidPath(grid, finder, path, si, sj, ti, tj, minI, minJ, maxI, maxJ)) valid++;
+            if (finder.LastCost() == reference) optimal++;
+            if (finder.LastCost() < reference) cheaper++;
+            if (finder.LastExpanded() == ReferenceExpanded(grid, finder.costs, si, sj, ti, tj, minI, minJ, maxI, maxJ))
+                sameOrder++;
+        }
+
+        Check(found == QUERIES && missed == 0, "every path found");
+        Check(valid == found, "paths step cell by cell and cost what they report");
+        Check(cheaper == 0, "no path cheaper than Dijkstra's");
+        Check(sameOrder == found, "cells expanded in the order of a heap-based A*");
+        if (weight == 100) Check(optimal == found, "unweighted costs match Dijkstra");
+    }
+}
+
+
+int main()
+{
+    MatchesDijkstra(100);
+    MatchesDijkstra(300);
+    return TestResult();
+}
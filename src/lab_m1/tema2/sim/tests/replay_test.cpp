@@ -0,0 +1,137 @@
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "lab_m1/tema2/sim/action_log.h"
+#include "lab_m1/tema2/sim/tests/test_check.h"
+#include "lab_m1/tema2/sim/train_sim.h"
+
+using namespace m1;
+
+
+// A scripted game is recorded, saved, loaded and replayed with one and with
+// several threads; every run has to pass through the same state hashes
+
+namespace
+{
+    const int TICKS = 9000;
+    const int HASH_EVERY = 500;
+    const float DT = 1.0f / 60.0f;
+    const int TRAINS_PER_STATION = 300;
+
+    TrainHandle Act(TrainSim& sim, ActionLog& log, const PlayerAction& action)
+    {
+        log.Record(action);
+        return sim.Perform(action);
+    }
+
+    void Link(TrainSim& sim, ActionLog& log, int from, int to)
+    {
+        Act(sim, log, PlayerAction::ConnectStation(sim.GetStations().pos[from]));
+        Act(sim, log, PlayerAction::ConnectStation(sim.GetStations().pos[to]));
+    }
+
+    // Enough trains at the station for the train update to run in parallel,
+    // every third with the wagons it can take
+    void Crowd(TrainSim& sim, ActionLog& log, int station)
+    {
+        int i, j;
+        sim.WorldToCell(sim.GetStations().pos[station], i, j);
+        for (int n = 0; n < TRAINS_PER_STATION; n++) {
+            TrainHandle train = Act(sim, log, PlayerAction::AtCell(PlayerActionKind::PlaceTrain, i, j));
+            if (n % 3 != 0) continue;
+            for (int w = 0; w < TrainSim::MAX_WAGONS; w++)
+                Act(sim, log, PlayerAction::AddWagon(train.slot, train.generation));
+        }
+    }
+
+    // First cell of open track, false when there is none
+    bool FindTrack(const TrainSim& sim, int& i, int& j)
+    {
+        for (i = 0; i < sim.GridHeight(); i++)
+            for (j = 0; j < sim.GridWidth(); j++)
+                if (sim.HasRailAt(i, j) && !sim.GetGrid().At(i, j).HasStation()) return true;
+        return false;
+    }
+
+    std::vector<uint64_t> Record(ActionLog& log)
+    {
+        SimConfig config;
+        config.sandbox = true;
+        config.gridWidth = 64;
+        config.gridHeight = 64;
+
+        TrainSim sim;
+        sim.Init(config);
+        log.Begin(config, DT);
+
+        std::vector<uint64_t> hashes;
+        int linked = 1;
+        for (int tick = 0; tick < TICKS; tick++) {
+            // Every new station joins the line, and gets its own trains
+            while (linked < sim.GetStations().Count()) {
+                Link(sim, log, linked - 1, linked);
+                if (linked == 1) Crowd(sim, log, 0);
+                Crowd(sim, log, linked);
+                linked++;
+            }
+
+            // Cut the line and lay it again, which removes the trains on it
+            int i, j;
+            if (tick == 3000 && FindTrack(sim, i, j))
+                Act(sim, log, PlayerAction::AtCell(PlayerActionKind::EraseRails, i, j));
+            if (tick == 3600) Link(sim, log, 0, 1);
+
+            sim.Tick(DT);
+            log.Tick();
+            if ((tick + 1) % HASH_EVERY == 0) hashes.push_back(sim.StateHash());
+        }
+        return hashes;
+    }
+
+    std::vector<uint64_t> Replay(const ActionLog& log, int threads)
+    {
+        SimConfig config = log.Config();
+        config.threads = threads;
+
+        TrainSim sim;
+        sim.Init(config);
+
+        std::vector<uint64_t> hashes;
+        const std::vector<PlayerAction>& actions = log.Actions();
+        size_t next = 0;
+        for (uint64_t tick = 0; tick < log.Ticks(); tick++) {
+            for (; next < actions.size() && actions[next].tick == tick; next++)
+                sim.Perform(actions[next]);
+
+            sim.Tick(log.Dt());
+            if ((tick + 1) % HASH_EVERY == 0) hashes.push_back(sim.StateHash());
+        }
+        return hashes;
+    }
+
+    void ReplayMatchesRecording()
+    {
+        ActionLog recorded;
+        std::vector<uint64_t> expected = Record(recorded);
+
+        const char* path = "replay_test.replay";
+        ActionLog loaded;
+        Check(recorded.Save(path) && loaded.Load(path), "recording saved and loaded");
+        std::remove(path);
+
+        Check(loaded.Ticks() == (uint64_t)TICKS, "all ticks recorded");
+        Check(loaded.Actions().size() > (size_t)2 * TRAINS_PER_STATION, "trains placed");
+        Check(expected.front() != expected.back(), "the game moved on");
+
+        Check(Replay(loaded, 1) == expected, "replay on one thread matches the recording");
+        Check(Replay(loaded, 4) == expected, "replay on four threads matches the recording");
+    }
+}
+
+
+int main()
+{
+    ReplayMatchesRecording();
+    return TestResult();
+}
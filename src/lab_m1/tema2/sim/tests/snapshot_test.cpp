@@ -0,0 +1,106 @@
+#include <cstdint>
+#include <cstdio>
+
+#include "lab_m1/tema2/sim/tests/test_check.h"
+#include "lab_m1/tema2/sim/train_sim.h"
+
+using namespace m1;
+
+
+// A game saved mid-run and loaded into a new TrainSim has to go on exactly as
+// the one it was saved from
+
+namespace
+{
+    const float DT = 1.0f / 60.0f;
+
+    // Links every station to the one before it and puts trains on the line
+    void Play(TrainSim& sim, int ticks, int& linked)
+    {
+        for (int tick = 0; tick < ticks; tick++) {
+            while (linked < sim.GetStations().Count()) {
+                if (linked > 0) {
+                    sim.Perform(PlayerAction::ConnectStation(sim.GetStations().pos[linked - 1]));
+                    sim.Perform(PlayerAction::ConnectStation(sim.GetStations().pos[linked]));
+
+                    int i, j;
+                    sim.WorldToCell(sim.GetStations().pos[linked], i, j);
+                    for (int n = 0; n < 20; n++) {
+                        TrainHandle train = sim.PlaceTrainAt(i, j);
+                        sim.AddWagon(train);
+                    }
+                }
+                linked++;
+            }
+            sim.Tick(DT);
+        }
+    }
+
+    void LoadedGameGoesOn()
+    {
+        SimConfig config;
+        config.sandbox = true;
+        config.gridWidth = 64;
+        config.gridHeight = 64;
+
+        TrainSim original;
+        original.Init(config);
+        int linked = 0;
+        Play(original, 4000, linked);
+
+        const char* path = "snapshot_test.snapshot";
+        Check(original.SaveSnapshot(path), "snapshot saved");
+
+        // Loaded over a game on another map, with another thread count
+        SimConfig other = config;
+        other.seed = config.seed + 1;
+        other.threads = 4;
+        TrainSim loaded;
+        loaded.Init(other);
+        Check(loaded.LoadSnapshot(path), "snapshot loaded");
+        std::remove(path);
+
+        Check(loaded.StateHash() == original.StateHash(), "same state right after loading");
+        Check(loaded.GetTrains().Count() > 0, "trains saved");
+
+        int loadedLinked = linked;
+        Play(original, 6000, linked);
+        Play(loaded, 6000, loadedLinked);
+        Check(loaded.StateHash() == original.StateHash(), "same state after running on");
+        Check(loaded.GetDeliveredPassengers() == original.GetDeliveredPassengers(), "same passengers delivered");
+    }
+
+    void BadFileLeavesGame()
+    {
+        SimConfig config;
+        config.gridWidth = 32;
+        config.gridHeight = 32;
+
+        TrainSim sim;
+        sim.Init(config);
+        int linked = 0;
+        Play(sim, 600, linked);
+        uint64_t before = sim.StateHash();
+
+        const char* path = "snapshot_test.bad";
+        FILE* file = std::fopen(path, "wb");
+        if (file) {
+            std::fputs("not a snapshot", file);
+            std::fclose(file);
+        }
+
+        Check(!sim.LoadSnapshot(path), "bad snapshot refused");
+        Check(!sim.LoadSnapshot("snapshot_test.missing"), "missing snapshot refused");
+        std::remove(path);
+
+        Check(sim.StateHash() == before, "game kept after a refused load");
+    }
+}
+
+
+int main()
+{
+    LoadedGameGoesOn();
+    BadFileLeavesGame();
+    return TestResult();
+}
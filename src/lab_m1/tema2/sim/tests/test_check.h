@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdio>
+
+
+// Minimal check helpers shared by the headless tests. Each test file is its
+// own executable and returns TestResult() from main.
+namespace m1
+{
+    inline int& TestFailures()
+    {
+        static int failures = 0;
+        return failures;
+    }
+
+    inline void Check(bool condition, const char* what)
+    {
+        if (!condition) {
+            printf("FAILED: %s\n", what);
+            TestFailures()++;
+        }
+    }
+
+    inline int TestResult()
+    {
+        if (TestFailures() == 0) printf("all checks passed\n");
+        return TestFailures() == 0 ? 0 : 1;
+    }
+}
@@ -0,0 +1,56 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "lab_m1/tema2/sim/tests/test_check.h"
+#include "lab_m1/tema2/sim/thread_pool.h"
+
+using namespace m1;
+
+
+namespace
+{
+    // Every item visited exactly once
+    bool CoversRange(ThreadPool& pool, int count)
+    {
+        std::vector<std::atomic<int>> visits(count);
+        for (std::atomic<int>& v : visits) v.store(0);
+
+        pool.ParallelFor(count, 16, [&visits](int begin, int end) {
+            for (int k = begin; k < end; k++) visits[k]++;
+        });
+
+        for (const std::atomic<int>& v : visits)
+            if (v.load() != 1) return false;
+        return true;
+    }
+
+    void RestartWithOtherThreadCount()
+    {
+        ThreadPool pool;
+        pool.Start(4);
+        Check(pool.Threads() == 4, "four threads");
+        Check(CoversRange(pool, 1000), "four threads cover the range");
+
+        // Workers of the new set must not wake on the old job. They get
+        // time to reach their wait first, or they would only ever see the
+        // next one.
+        pool.Start(2);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        Check(pool.Threads() == 2, "two threads after restart");
+        Check(CoversRange(pool, 1000), "two threads cover the range");
+        Check(CoversRange(pool, 1000), "and keep covering it");
+
+        pool.Start(4);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        Check(CoversRange(pool, 1000), "four threads again");
+    }
+}
+
+
+int main()
+{
+    RestartWithOtherThreadCount();
+    return TestResult();
+}
@@ -0,0 +1,130 @@
+#include <vector>
+
+#include "lab_m1/tema2/sim/tests/test_check.h"
+#include "lab_m1/tema2/sim/train_sim.h"
+
+using namespace m1;
+
+
+// Headless checks of the parallel train update, run by ctest
+
+namespace
+{
+    // Two linked stations with many full trains that have no target and
+    // nothing to drop at either station, so every arrival has to pick a
+    // target
+    class TargetProbe : public TrainSim
+    {
+    public:
+        static constexpr int TRAINS_PER_STATION = 600;
+
+        void Build(int threads)
+        {
+            SimConfig config;
+            config.sandbox = true;
+            config.gridWidth = 64;
+            config.gridHeight = 64;
+            config.threads = threads;
+            Init(config);
+
+            HandleStationConnection(stations.pos[0]);
+            HandleStationConnection(stations.pos[1]);
+
+            for (int s = 0; s < SHAPE_COUNT; s++)
+                if (s != (int)stations.shape[0] && s != (int)stations.shape[1]) cargo = (StationShape)s;
+
+            for (int st = 0; st < 2; st++) {
+                int i, j;
+                WorldToCell(stations.pos[st], i, j);
+                for (int n = 0; n < TRAINS_PER_STATION; n++) {
+                    TrainHandle train = PlaceTrainAt(i, j);
+                    while (AddWagon(train)) {}
+                }
+            }
+        }
+
+        // Every train full and without a target, and both stations crowded
+        // enough to be worth heading for
+        void Reset()
+        {
+            for (PassengerCounts& waiting : stations.waiting) {
+                waiting = PassengerCounts();
+                waiting.Add(cargo, 8);
+            }
+            for (int k = 0; k < trains.Count(); k++) {
+                trains.passengers[k] = PassengerCounts();
+                trains.passengers[k].Add(cargo, TrainCapacity(k));
+                trains.target[k] = -1;
+            }
+        }
+
+        // Returns how many trains picked a target during the tick
+        int Step()
+        {
+            Reset();
+            Tick(1.0f / 60.0f);
+
+            int chosen = 0;
+            for (int k = 0; k < trains.Count(); k++)
+                if (trains.target[k] >= 0) chosen++;
+            return chosen;
+        }
+
+        bool RunsInParallel() const { return trains.Count() > 2 * PARALLEL_MIN_TRAINS; }
+
+        // The parallel pass must leave the target choice to the serial one
+        bool ParallelArrivalDefers()
+        {
+            Reset();
+            for (int k = 0; k < trains.Count(); k++) {
+                if (GetStationAtCell(trains.i[k], trains.j[k]) < 0) continue;
+
+                bool done = ArriveTrain(k, false);
+                return !done && trains.target[k] == -1;
+            }
+            return false;
+        }
+
+        std::vector<int> State() const
+        {
+            std::vector<int> state;
+            for (int k = 0; k < trains.Count(); k++) {
+                state.push_back(trains.i[k]);
+                state.push_back(trains.j[k]);
+                state.push_back(trains.dir[k]);
+                state.push_back(trains.target[k]);
+            }
+            return state;
+        }
+
+    private:
+        StationShape cargo = StationShape::Circle;
+    };
+
+    void FullTrainsChooseTargetsSerially()
+    {
+        TargetProbe serial, parallel;
+        serial.Build(1);
+        parallel.Build(4);
+
+        Check(parallel.RunsInParallel(), "enough trains for the parallel pass");
+        Check(serial.ParallelArrivalDefers() && parallel.ParallelArrivalDefers(),
+            "full train without target defers its arrival");
+
+        int chosen = 0;
+        for (int tick = 0; tick < 3000; tick++) {
+            serial.Step();
+            chosen += parallel.Step();
+        }
+
+        Check(chosen > 0, "full trains arriving at stations picked targets");
+        Check(serial.State() == parallel.State(), "same trains for 1 and 4 threads");
+    }
+}
+
+
+int main()
+{
+    FullTrainsChooseTargetsSerially();
+    return TestResult();
+}
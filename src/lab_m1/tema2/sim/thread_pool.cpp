@@ -0,0 +1,111 @@
+#include "lab_m1/tema2/sim/thread_pool.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace m1;
+
+
+ThreadPool::ThreadPool()
+{
+    threadCount = 1;
+    job = nullptr;
+    jobCount = 0;
+    jobThreads = 0;
+    jobGeneration = 0;
+    pendingWorkers = 0;
+    stopping = false;
+}
+
+ThreadPool::~ThreadPool()
+{
+    Stop();
+}
+
+void ThreadPool::Start(int threads)
+{
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    if (threads == threadCount && (int)workers.size() == threads - 1) return;
+
+    Stop();
+
+    threadCount = threads;
+    stopping = false;
+    for (int w = 1; w < threads; w++)
+        workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, w));
+}
+
+void ThreadPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    // Workers of a later Start begin counting from zero again
+    workers.clear();
+    threadCount = 1;
+    jobGeneration = 0;
+}
+
+void ThreadPool::ParallelFor(int count, int minPerThread, const std::function<void(int, int)>& work)
+{
+    int threads = std::min(threadCount, count / std::max(minPerThread, 1));
+    if (threads <= 1) {
+        if (count > 0) work(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &work;
+        jobCount = count;
+        jobThreads = threads;
+        pendingWorkers = (int)workers.size();
+        jobGeneration++;
+    }
+    wake.notify_all();
+
+    work(0, count / threads);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pendingWorkers == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::WorkerLoop(int index)
+{
+    uint64_t seenGeneration = 0;
+
+    while (true) {
+        const std::function<void(int, int)>* work;
+        int count, threads;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || jobGeneration != seenGeneration; });
+            if (stopping) return;
+
+            seenGeneration = jobGeneration;
+            work = job;
+            count = jobCount;
+            threads = jobThreads;
+        }
+
+        if (index < threads) {
+            int begin = (int)((long long)count * index / threads);
+            int end = (int)((long long)count * (index + 1) / threads);
+            (*work)(begin, end);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pendingWorkers--;
+        }
+        done.notify_one();
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace m1
+{
+    // Fixed set of worker threads for data-parallel loops. ParallelFor cuts
+    // the range into one contiguous slice per thread, never smaller than
+    // minPerThread items, so short loops stay on the calling thread. The
+    // caller works on the first slice instead of waiting idle.
+    class ThreadPool
+    {
+    public:
+        ThreadPool();
+        ~ThreadPool();
+
+        // Total thread count, the caller included. 0 uses every hardware
+        // thread; 1 runs everything on the caller.
+        void Start(int threads);
+        void Stop();
+        int Threads() const { return threadCount; }
+
+        void ParallelFor(int count, int minPerThread, const std::function<void(int begin, int end)>& job);
+
+    private:
+        ThreadPool(const ThreadPool&);
+        ThreadPool& operator=(const ThreadPool&);
+
+        void WorkerLoop(int index);
+
+        int threadCount;
+        std::vector<std::thread> workers;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+
+        const std::function<void(int, int)>* job;
+        int jobCount;
+        int jobThreads;
+        uint64_t jobGeneration;
+        int pendingWorkers;
+        bool stopping;
+    };
+}
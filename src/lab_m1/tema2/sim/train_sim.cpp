@@ -0,0 +1,1406 @@
+#include "lab_m1/tema2/sim/train_sim.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "lab_m1/tema2/sim/cell_board.h"
+#include "lab_m1/tema2/sim/snapshot.h"
+
+using namespace std;
+using namespace m1;
+
+constexpr float TrainSim::CELL_SIZE;
+constexpr float TrainSim::TRAIN_Y_OFFSET;
+constexpr int TrainSim::MIN_GRID_SIZE;
+constexpr int TrainSim::MAX_GRID_SIZE;
+constexpr float TrainSim::LOCOMOTIVE_LENGTH;
+constexpr float TrainSim::WAGON_SPACING;
+constexpr int TrainSim::MAX_WAGONS;
+constexpr int TrainSim::TRAIN_COST;
+constexpr int TrainSim::WAGON_COST;
+constexpr float TrainSim::TRAIN_SPEED;
+constexpr int TrainSim::PARALLEL_MIN_TRAINS;
+
+
+namespace
+{
+    // ===== SNAPSHOT FORMAT =====
+    // Bump whenever a section below changes. Train fields are stored one
+    // section per field, like TrainStore keeps them.
+    const uint32_t SNAPSHOT_VERSION = 2;
+
+    enum SnapshotSectionId : uint32_t {
+        SNAP_STATE = 1,
+        SNAP_CHUNK_VALUES,      // Cell per chunk, the value of uniform chunks
+        SNAP_DENSE_CHUNKS,      // index of every chunk stored cell by cell
+        SNAP_CELLS,             // CHUNK_CELLS cells per dense chunk, in that order
+        SNAP_STATIONS,
+        SNAP_EVENTS,
+        SNAP_SLOTS,             // slot of every train
+        SNAP_GENERATIONS,       // per slot
+        SNAP_FREE_SLOTS,
+        SNAP_TRAIN_I,
+        SNAP_TRAIN_J,
+        SNAP_TRAIN_DIR,
+        SNAP_TRAIN_PROGRESS,
+        SNAP_TRAIN_MOVED,
+        SNAP_TRAIN_STOPPING,
+        SNAP_TRAIN_WAGONS,
+        SNAP_TRAIN_STATION,
+        SNAP_TRAIN_TARGET,
+        SNAP_TRAIN_PASSENGERS,
+        SNAP_TRAIL_SIZES,       // points per train
+        SNAP_TRAIL_POINTS       // oldest first, train after train
+    };
+
+    struct SavedState
+    {
+        int32_t gridWidth, gridHeight;
+        uint32_t seed;
+        uint8_t sandbox, gameOver;
+        uint8_t shapesSeen[SHAPE_COUNT];
+        uint8_t padding[3];
+        int32_t selectedStation;
+        int32_t deliveredPassengers;
+        int32_t points;
+        double gameTime;
+        double eventTime;
+        uint64_t eventSequence;
+        uint64_t randomState[3];
+        uint64_t randomIncrement[3];
+    };
+
+    struct SavedStation
+    {
+        int32_t i, j;
+        int32_t shape;
+        int32_t waiting[SHAPE_COUNT];
+        uint32_t fullToken;
+    };
+
+    struct SavedEvent
+    {
+        double time;
+        int32_t kind;
+        int32_t id;
+        uint32_t token;
+        uint32_t padding;
+        uint64_t sequence;
+    };
+
+    // Sections that are copied straight into the live arrays
+    static_assert(sizeof(int) == 4, "train fields are saved as 32-bit ints");
+    static_assert(sizeof(PassengerCounts) == (SHAPE_COUNT + 1) * sizeof(int), "passenger counts are plain ints");
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "trail points are three floats");
+
+    // Counts as the game keeps them: none negative, total their sum
+    bool ValidPassengers(const PassengerCounts& counts)
+    {
+        int sum = 0;
+        for (int s = 0; s < SHAPE_COUNT; s++) {
+            if (counts.byShape[s] < 0) return false;
+            sum += counts.byShape[s];
+        }
+        return counts.total == sum;
+    }
+}
+
+/* =========================================================
+ *  Constructor / Destructor
+ * ========================================================= */
+TrainSim::TrainSim()
+{
+    gameOver = circleExists = squareExists = pyramidExists = false;
+    selectedStation = -1;
+    gameTime = 0.0;
+    totalDeliveredPassengers = 0;
+    currentPoints = 0;
+}
+
+TrainSim::~TrainSim() {}
+
+/* =========================================================
+ *  Init
+ * ========================================================= */
+void TrainSim::Init(const SimConfig& simConfig)
+{
+    config = simConfig;
+    pathfinder.SetCosts(config.pathCosts);
+    workers.Start(config.threads);
+    terrain.Load(config.terrain);
+    terrainRandom.Seed(config.seed, TERRAIN_STREAM);
+    stationRandom.Seed(config.seed, STATION_STREAM);
+    passengerRandom.Seed(config.seed, PASSENGER_STREAM);
+    config.gridWidth = std::min(std::max(config.gridWidth, MIN_GRID_SIZE), MAX_GRID_SIZE);
+    config.gridHeight = std::min(std::max(config.gridHeight, MIN_GRID_SIZE), MAX_GRID_SIZE);
+    RestartGame();
+}
+
+/* =========================================================
+ *  Grid init
+ * ========================================================= */
+void TrainSim::InitGrid()
+{
+    // Grass
+    grid.Assign(config.gridWidth, config.gridHeight, Cell());
+    // end
+
+    // River, lakes and mountains
+    terrain.Generate(grid, terrainRandom.Next(), workers);
+    grid.Compact();
+    // end
+
+    stationIndex.Assign(grid.Width(), grid.Height(), -1);
+    stationSites.Build(grid);
+    chunkRailCells.Assign(grid.ChunksX(), grid.ChunksY(), 0);
+    brokenRailChunks.Assign(grid.ChunksX(), grid.ChunksY(), 0);
+    brokenChunkList.clear();
+
+    pathfinder.Reset(grid.Width(), grid.Height());
+    network.Reset(grid.Width(), grid.Height());
+    routes.Reset();
+    blocks.Reset(grid.Width(), grid.Height());
+}
+
+/* =========================================================
+ *  Grid helpers
+ * ========================================================= */
+glm::vec3 TrainSim::CellToWorld(int i, int j) const
+{
+    float x = (j - GridWidth() / 2) * CELL_SIZE + CELL_SIZE * 0.5f;
+    float z = (i - GridHeight() / 2) * CELL_SIZE + CELL_SIZE * 0.5f;
+    return glm::vec3(x, 0.0f, z);
+}
+
+bool TrainSim::WorldToCell(const glm::vec3& p, int& i, int& j) const
+{
+    j = int((p.x + GridWidth() * CELL_SIZE / 2) / CELL_SIZE);
+    i = int((p.z + GridHeight() * CELL_SIZE / 2) / CELL_SIZE);
+    return grid.InBounds(i, j);
+}
+
+/* =========================================================
+ *  Tick
+ * ========================================================= */
+void TrainSim::Tick(float dt)
+{
+    if (gameOver) return;
+
+    gameTime += dt;
+
+    // ***** TIMED EVENTS *****
+    // Spawns, full stations and station stops
+    events.Advance(dt);
+
+    EventScheduler::Event event;
+    while (!gameOver && events.PopDue(event))
+        HandleEvent(event);
+
+    if (gameOver) return;
+
+    // ***** UPDATE TRAINS *****
+    UpdateGridTrains(dt);
+}
+
+void TrainSim::HandleEvent(const EventScheduler::Event& event)
+{
+    switch ((SimEvent)event.kind)
+    {
+    case SimEvent::StationSpawn:
+        SpawnRandomStation();
+        events.Schedule(stationSpawnInterval, (int)SimEvent::StationSpawn, 0);
+        break;
+
+    case SimEvent::PassengerSpawn:
+        SpawnPassengers();
+        events.Schedule(passengerSpawnInterval, (int)SimEvent::PassengerSpawn, 0);
+        break;
+
+    case SimEvent::StationFull:
+        // Still full since the deadline was set
+        if (event.token == stations.fullToken[event.id] && !config.sandbox)
+            gameOver = true;
+        break;
+
+    case SimEvent::StationStop:
+    {
+        TrainHandle handle;
+        handle.slot = (uint32_t)event.id;
+        handle.generation = event.token;
+
+        int k = trains.Find(handle);
+        if (k < 0 || !trains.stopping[k]) break;
+
+        ProcessStationPassengers(k);
+        if (trains.stopping[k]) ScheduleStationStop(k);
+        break;
+    }
+    }
+}
+
+void TrainSim::SpawnPassengers()
+{
+    for (StationShape shape : stations.shape)
+    {
+        if (shape == StationShape::Circle) circleExists = true;
+        if (shape == StationShape::Square) squareExists = true;
+        if (shape == StationShape::Pyramid) pyramidExists = true;
+    }
+
+    for (int s = 0; s < stations.Count(); s++)
+    {
+        PassengerCounts& waiting = stations.waiting[s];
+        if (waiting.total >= 10) continue;
+
+        int r = passengerRandom.Below(3);
+        StationShape type = (StationShape)r;
+
+        if (type == stations.shape[s]) continue;
+
+        if ((type == StationShape::Pyramid && pyramidExists)
+            || (type == StationShape::Circle && circleExists)
+            || (type == StationShape::Square && squareExists))
+        {
+            waiting.Add(type);
+            if (waiting.total == 10)
+                events.Schedule(stationMaxFullnessTimer, (int)SimEvent::StationFull, s, stations.fullToken[s]);
+        }
+    }
+}
+
+/* =========================================================
+ *  Player actions
+ * ========================================================= */
+void TrainSim::HandleStationConnection(const glm::vec3& hit)
+{
+    int stationId = PickStationAt(hit);
+    if (stationId < 0) return;
+
+    if (selectedStation < 0) {
+        selectedStation = stationId;
+        return;
+    }
+
+    if (selectedStation == stationId) {
+        selectedStation = -1;
+        return;
+    }
+
+    BuildRailPath(selectedStation, stationId);
+    selectedStation = -1;
+}
+
+bool TrainSim::AddWagon(TrainHandle train)
+{
+    int k = trains.Find(train);
+    if (k < 0) return false;
+    if (trains.wagons[k] >= MAX_WAGONS) return false;
+    if (!config.sandbox && currentPoints < WAGON_COST) return false;
+
+    trains.wagons[k]++;
+    FitTrainTrail(k);
+    if (!config.sandbox) currentPoints -= WAGON_COST;
+    return true;
+}
+
+TrainHandle TrainSim::PlaceTrainAt(int i, int j)
+{
+    if (!HasRailAt(i, j)) return TrainHandle();
+    if (!config.sandbox && currentPoints < TRAIN_COST) return TrainHandle();
+
+    // Refused when another train holds the cell, which costs nothing
+    TrainHandle train = SpawnTrainAtCell(i, j);
+    int k = trains.Find(train);
+    if (k < 0) return train;
+
+    trains.wagons[k]++;
+    FitTrainTrail(k);
+    if (!config.sandbox) currentPoints -= TRAIN_COST;
+    return train;
+}
+
+bool TrainSim::EraseRailsAt(int i, int j)
+{
+    if (!HasRailAt(i, j)) return false;
+
+    EraseRailFromCell(i, j);
+    RemoveTrainsOnBrokenRails();
+    return true;
+}
+
+TrainHandle TrainSim::Perform(const PlayerAction& action)
+{
+    TrainHandle train;
+
+    switch (action.kind)
+    {
+    case PlayerActionKind::ConnectStation:
+        HandleStationConnection(glm::vec3(action.x, 0.0f, action.z));
+        break;
+
+    case PlayerActionKind::AddWagon:
+        train.slot = action.slot;
+        train.generation = action.generation;
+        if (!AddWagon(train)) train = TrainHandle();
+        break;
+
+    case PlayerActionKind::PlaceTrain:
+        train = PlaceTrainAt(action.i, action.j);
+        break;
+
+    case PlayerActionKind::EraseRails:
+        EraseRailsAt(action.i, action.j);
+        break;
+
+    case PlayerActionKind::Restart:
+        RestartGame();
+        break;
+    }
+
+    return train;
+}
+
+/* =========================================================
+ *  Station
+ * ========================================================= */
+bool TrainSim::SpawnRandomStation()
+{
+    int i, j;
+    if (!stationSites.Sample(stationRandom, i, j))
+        return false;
+
+    glm::vec3 pos = CellToWorld(i, j);
+
+    StationShape shape;
+    int shapeTypeChance = stationRandom.Below(3);
+    if (shapeTypeChance == 0) shape = StationShape::Square;
+    else if (shapeTypeChance == 1) shape = StationShape::Circle;
+    else shape = StationShape::Pyramid;
+
+    AddStation(pos, shape);
+
+    return true;
+}
+
+void TrainSim::AddStation(const glm::vec3& pos, StationShape shape)
+{
+    int i, j;
+    if (!WorldToCell(pos, i, j)) return;
+
+    int id = stations.Add(pos, shape);
+
+    grid.Edit(i, j).SetStation(true);
+    stationIndex.Set(i, j, id);
+    stationSites.Exclude(i, j);
+    network.InvalidateCell(i, j);
+}
+
+int TrainSim::PickStationAt(const glm::vec3& p) const
+{
+    int i, j;
+    WorldToCell(p, i, j);
+
+    // The pick radius is below one cell, so only neighbouring cells can hold
+    // a station close enough to the point.
+    int best = -1;
+    for (int ni = i - 1; ni <= i + 1; ni++) {
+        for (int nj = j - 1; nj <= j + 1; nj++) {
+            if (!stationIndex.InBounds(ni, nj)) continue;
+
+            int id = stationIndex.At(ni, nj);
+            if (id < 0 || (best >= 0 && id > best)) continue;
+            if (glm::distance(stations.pos[id], p) < pickRadius) best = id;
+        }
+    }
+    return best;
+}
+
+int TrainSim::GetStationAtCell(int i, int j) const
+{
+    return stationIndex.At(i, j);
+}
+
+/* =========================================================
+ *  Train Spawning and Updating
+ * ========================================================= */
+TrainHandle TrainSim::SpawnTrainAtCell(int i, int j)
+{
+    if (IsBlock(i, j) && blocks.Holder(i, j) >= 0)
+        return TrainHandle();
+
+    TrainHandle train = trains.Add();
+    int k = trains.Count() - 1;
+    trains.i[k] = i;
+    trains.j[k] = j;
+    trains.progress[k] = 0.0f;
+    trains.dir[k] = 0;
+    if (IsBlock(i, j)) blocks.Hold(i, j, train.slot);
+
+    FitTrainTrail(k);
+    trains.trail[k].Reset(GetTrainPos(k));
+
+    unsigned char m = grid.At(i, j).RailMask();
+    if (m & UP) trains.dir[k] = 0;
+    else if (m & RIGHT) trains.dir[k] = 1;
+    else if (m & DOWN) trains.dir[k] = 2;
+    else if (m & LEFT) trains.dir[k] = 3;
+
+    return train;
+}
+
+void TrainSim::UpdateGridTrains(float dt)
+{
+    network.Sync(grid);
+
+    // Trains only read routes while they move, so rail changes are
+    // repaired into them here first. Only the fields of stations some train
+    // heads for are worth repairing; the rest are built again when needed.
+    if (!network.ChangedNodes().empty()) {
+        targetedStations.assign(stations.Count(), 0);
+        for (int k = 0; k < trains.Count(); k++)
+            if (trains.target[k] >= 0) targetedStations[trains.target[k]] = 1;
+        routes.Retain(targetedStations);
+    }
+    routes.Update(network, stations, [this](int node) { return StationAtNode(node); });
+    network.ClearChanges();
+
+    int count = trains.Count();
+    trainPending.resize(count);
+
+    // Everything a train can do on its own runs in parallel. Reading the
+    // passengers waiting at a station or scheduling the stop is left
+    // pending and done afterwards in train order, so every train sees the
+    // stations exactly as the serial loop would have left them.
+    //
+    // A train about to leave its cell claims the next one first, and only
+    // moves in on a second pass, once every claim of the tick is in.
+    workers.ParallelFor(count, PARALLEL_MIN_TRAINS, [this, dt](int begin, int end) {
+        for (int k = begin; k < end; k++)
+            trainPending[k] = AdvanceTrain(k, dt);
+    });
+
+    workers.ParallelFor(count, PARALLEL_MIN_TRAINS, [this](int begin, int end) {
+        for (int k = begin; k < end; k++)
+            if (trainPending[k] == TrainPending::Entry)
+                trainPending[k] = EnterBlock(k);
+    });
+
+    for (int k = 0; k < count; k++) {
+        if (trainPending[k] != TrainPending::None)
+            FinishTrain(k, trainPending[k]);
+    }
+}
+
+TrainSim::TrainPending TrainSim::AdvanceTrain(int k, float dt)
+{
+    // Stopped trains wait for their next StationStop event
+    if (trains.stopping[k]) {
+        trains.moved[k] = 0.0f;
+        return TrainPending::None;
+    }
+
+    trains.moved[k] = dt * TRAIN_SPEED;
+    trains.progress[k] += trains.moved[k];
+
+    return RequestBlock(k);
+}
+
+void TrainSim::FinishTrain(int k, TrainPending pending)
+{
+    if (pending == TrainPending::Arrival)
+        ArriveTrain(k, true);
+    else if (pending == TrainPending::Blocked)
+        ResolveBlock(k);
+
+    if (trains.stopping[k])
+        ScheduleStationStop(k);
+}
+
+TrainSim::TrainPending TrainSim::RequestBlock(int k)
+{
+    int& i = trains.i[k];
+    int& j = trains.j[k];
+    int& dir = trains.dir[k];
+    RailCursor& cursor = trains.cursor[k];
+
+    if (trains.progress[k] < 1.0f) return TrainPending::None;
+
+    if (!network.IsValid(cursor) && !network.Locate(i, j, dir, cursor))
+    {
+        trains.progress[k] -= 1.0f;
+        dir = OppositeDir(dir);
+        ResetTrainTrail(k);
+        return TrainPending::None;
+    }
+
+    int ni = i + di[dir];
+    int nj = j + dj[dir];
+    if (IsBlock(ni, nj)) blocks.Claim(ni, nj, trains.HandleAt(k).slot);
+    return TrainPending::Entry;
+}
+
+TrainSim::TrainPending TrainSim::EnterBlock(int k)
+{
+    int& i = trains.i[k];
+    int& j = trains.j[k];
+    int& dir = trains.dir[k];
+    float& progress = trains.progress[k];
+    RailCursor& cursor = trains.cursor[k];
+
+    // Losers wait at the edge of their cell
+    int ni = i + di[dir];
+    int nj = j + dj[dir];
+    if (IsBlock(ni, nj) && !blocks.Enter(ni, nj, trains.HandleAt(k).slot)) {
+        trains.moved[k] -= progress - 1.0f;
+        progress = 1.0f;
+        return TrainPending::Blocked;
+    }
+
+    // One cell per tick, so a train never claims twice in one pass
+    if (IsBlock(i, j)) blocks.Release(i, j);
+    progress = std::min(progress - 1.0f, 1.0f);
+
+    cursor.offset++;
+    network.CursorCell(cursor, i, j, dir);
+    UpdateTrainTrail(k);
+
+    // Plain track in between: the edge already knows where it goes
+    if (cursor.offset < network.Length(cursor))
+        return TrainPending::None;
+
+    // Reached a node; the next step picks the edge leaving it
+    cursor.edge = -1;
+    if (!ArriveTrain(k, false))
+        return TrainPending::Arrival;
+
+    return trains.stopping[k] ? TrainPending::Stopped : TrainPending::None;
+}
+
+bool TrainSim::ArriveTrain(int k, bool shared)
+{
+    // Returns false, with nothing changed, when deciding whether to stop
+    // needs the waiting passengers and shared state is off limits
+    int stationId = GetStationAtCell(trains.i[k], trains.j[k]);
+    if (stationId >= 0)
+    {
+        const PassengerCounts& passengers = trains.passengers[k];
+        bool hasPassengersToDrop = passengers.Of(stations.shape[stationId]) > 0;
+        bool canPickUpPassengers = false;
+
+        // Picking a target also needs shared state: it reads the stations
+        // and prepares route fields, which only the serial pass may do
+        bool hasRoom = passengers.total < TrainCapacity(k);
+        bool reachedTarget = trains.target[k] == stationId;
+        bool choosesTarget = trains.target[k] < 0 || reachedTarget;
+        if (!hasPassengersToDrop && (hasRoom || choosesTarget) && !shared)
+            return false;
+
+        if (hasRoom && !stations.waiting[stationId].Empty())
+        {
+            canPickUpPassengers = true;
+        }
+
+        if (hasPassengersToDrop || canPickUpPassengers)
+        {
+            StartStationStop(k, stationId);
+            return true;
+        }
+
+        if (choosesTarget)
+            ChooseTrainTarget(k, stationId);
+    }
+
+    trains.dir[k] = TrainExitDir(k, false);
+    return true;
+}
+
+void TrainSim::ResolveBlock(int k)
+{
+    // Two trains facing each other would wait forever; the first one in
+    // train order that has another way out backs off. Trains behind a
+    // stopped or leaving train just wait.
+    int i = trains.i[k];
+    int j = trains.j[k];
+    int holder = blocks.Holder(i + di[trains.dir[k]], j + dj[trains.dir[k]]);
+    if (holder < 0) return;
+
+    int h = trains.IndexOfSlot((uint32_t)holder);
+    if (trains.stopping[h]) return;
+    if (trains.i[h] + di[trains.dir[h]] != i || trains.j[h] + dj[trains.dir[h]] != j) return;
+
+    int back = ReverseDir(i, j, trains.dir[k]);
+    if (back < 0) return;
+
+    trains.dir[k] = back;
+    trains.progress[k] = 0.0f;
+    trains.cursor[k].edge = -1;
+    ResetTrainTrail(k);
+}
+
+int TrainSim::ReverseDir(int i, int j, int dir) const
+{
+    // Any other track out of the cell; on plain track that is the way back
+    unsigned char mask = grid.At(i, j).RailMask() & ~DirToMask(dir);
+    for (int d = 0; d < 4; d++)
+        if (mask & DirToMask(d))
+            return d;
+    return -1;
+}
+
+void TrainSim::ScheduleStationStop(int k)
+{
+    TrainHandle handle = trains.HandleAt(k);
+    events.Schedule(stationStopInterval, (int)SimEvent::StationStop, (int)handle.slot, handle.generation);
+}
+
+void TrainSim::ResetTrainTrail(int k)
+{
+    trains.trail[k].Reset(GetTrainPos(k));
+}
+
+void TrainSim::UpdateTrainTrail(int k)
+{
+    // Called as the train enters a cell; in between it moves in a straight
+    // line, so the cell centres are all the trail needs
+    trains.trail[k].Push(CellToWorld(trains.i[k], trains.j[k]) + glm::vec3(0, TRAIN_Y_OFFSET, 0));
+}
+
+void TrainSim::FitTrainTrail(int k)
+{
+    // One point per cell covered, plus the partial cells at either end
+    float length = LOCOMOTIVE_LENGTH + trains.wagons[k] * WAGON_SPACING;
+    trains.trail[k].SetCapacity((int)std::ceil(length / CELL_SIZE) + 2);
+}
+
+int TrainSim::ChooseNextDirection(int i, int j, int currentDir) const
+{
+    unsigned char mask = grid.At(i, j).RailMask();
+    int backDir = OppositeDir(currentDir);
+
+    if (mask & DirToMask(currentDir))
+        return currentDir;
+
+    for (int d = 0; d < 4; d++) {
+        if (d == backDir) continue;
+        if (mask & DirToMask(d))
+            return d;
+    }
+
+    return backDir;
+}
+
+void TrainSim::ProcessStationPassengers(int k)
+{
+    int stationId = trains.stationId[k];
+    StationShape shape = stations.shape[stationId];
+    PassengerCounts& waiting = stations.waiting[stationId];
+    PassengerCounts& passengers = trains.passengers[k];
+
+    // Descarcare
+    if (passengers.Of(shape) > 0)
+    {
+        passengers.Remove(shape);
+        totalDeliveredPassengers++;
+        currentPoints++;
+        return;
+    }
+    // end
+
+    // Incarcare
+    if (passengers.total < TrainCapacity(k) && !waiting.Empty())
+    {
+        StationShape type = waiting.Largest();
+        waiting.Remove(type);
+        passengers.Add(type);
+
+        // No longer full, so the pending game over no longer applies
+        if (waiting.total == 9) stations.fullToken[stationId]++;
+        return;
+    }
+    // end
+
+    // Plecare
+    ChooseTrainTarget(k, stationId);
+    trains.stopping[k] = 0;
+    trains.stationId[k] = -1;
+
+    // Trains may leave a station the way they came; the wagons then follow
+    // from the station rather than along the old trail. Not into a train
+    // queued behind, though, which would have to back off all the way.
+    int i = trains.i[k];
+    int j = trains.j[k];
+    int exit = TrainExitDir(k, true);
+    bool reverses = exit == OppositeDir(trains.dir[k]);
+    if (reverses && blocks.Holder(i + di[exit], j + dj[exit]) >= 0) {
+        exit = TrainExitDir(k, false);
+        reverses = exit == OppositeDir(trains.dir[k]);
+    }
+    trains.dir[k] = exit;
+    if (reverses) ResetTrainTrail(k);
+    // end
+}
+
+void TrainSim::StartStationStop(int k, int stationId)
+{
+    trains.stopping[k] = 1;
+    trains.stationId[k] = stationId;
+}
+
+/* =========================================================
+ *  Dispatch
+ * ========================================================= */
+int TrainSim::StationAtNode(int node) const
+{
+    const RailNetwork::Node& info = network.GetNode(node);
+    return stationIndex.At(info.i, info.j);
+}
+
+void TrainSim::ChooseTrainTarget(int k, int atStation)
+{
+    // Demand per straight distance: passengers on board count double at the
+    // station they are for, waiting passengers count up to the room left,
+    // and a station about to overflow gets extra weight. Only the station
+    // picked gets a route field, so the cache holds fields for where trains
+    // go rather than for every station of the line.
+    trains.target[k] = -1;
+
+    int from = network.NodeIdAt(trains.i[k], trains.j[k]);
+    if (from < 0) return;
+
+    const PassengerCounts& onboard = trains.passengers[k];
+    int room = TrainCapacity(k) - onboard.total;
+    float bestScore = 0.0f;
+    int best = -1;
+
+    for (int s = 0; s < stations.Count(); s++) {
+        if (s == atStation) continue;
+
+        int si, sj;
+        if (!WorldToCell(stations.pos[s], si, sj) || !network.Connected(trains.i[k], trains.j[k], si, sj))
+            continue;
+
+        int waiting = stations.waiting[s].total;
+        int demand = 2 * onboard.Of(stations.shape[s]) + std::min(waiting, room);
+        if (waiting >= 8) demand += 4;
+        if (demand == 0) continue;
+
+        int distance = std::abs(si - trains.i[k]) + std::abs(sj - trains.j[k]);
+        float score = demand / (distance + 8.0f);
+        if (score > bestScore) {
+            bestScore = score;
+            best = s;
+        }
+    }
+    if (best < 0) return;
+
+    routes.Prepare(network, best, [this](int node) { return StationAtNode(node); });
+    if (routes.Distance(best, from) >= 0) trains.target[k] = best;
+}
+
+int TrainSim::TrainExitDir(int k, bool mayReverse) const
+{
+    int i = trains.i[k];
+    int j = trains.j[k];
+    int dir = trains.dir[k];
+
+    // Trains without a target still head for a station that takes most of
+    // their passengers; off any route they keep the old rule
+    int node = network.NodeIdAt(i, j);
+    int excludedDir = mayReverse ? -1 : OppositeDir(dir);
+    int exit = -1;
+    if (trains.target[k] >= 0)
+        exit = routes.StationExit(network, trains.target[k], node, excludedDir);
+    else if (!trains.passengers[k].Empty())
+        exit = routes.ShapeExit(network, trains.passengers[k].Largest(), node, excludedDir);
+
+    return exit >= 0 ? exit : ChooseNextDirection(i, j, dir);
+}
+
+/* =========================================================
+ *  Train Positioning, Direction and Misc. Info
+ * ========================================================= */
+glm::vec3 TrainSim::GetTrainPos(int k) const
+{
+    int i = trains.i[k];
+    int j = trains.j[k];
+    glm::vec3 p1 = CellToWorld(i, j);
+
+    int ni = i + di[trains.dir[k]];
+    int nj = j + dj[trains.dir[k]];
+
+    glm::vec3 p2 = p1;
+    if (grid.InBounds(ni, nj)) p2 = CellToWorld(ni, nj);
+
+    return glm::mix(p1, p2, trains.progress[k]) + glm::vec3(0, TRAIN_Y_OFFSET, 0);
+}
+
+glm::vec3 TrainSim::GetTrainDir(int k) const
+{
+    int i = trains.i[k];
+    int j = trains.j[k];
+    glm::vec3 p1 = CellToWorld(i, j);
+
+    int ni = i + di[trains.dir[k]];
+    int nj = j + dj[trains.dir[k]];
+
+    glm::vec3 p2 = p1;
+    if (grid.InBounds(ni, nj)) p2 = CellToWorld(ni, nj);
+
+    glm::vec3 d = p2 - p1;
+    d.y = 0;
+    if (glm::length(d) < 0.001f) return glm::vec3(1, 0, 0);
+
+    return glm::normalize(d);
+}
+
+TrainHandle TrainSim::PickGridTrainAt(const glm::vec3& p) const
+{
+    int i, j;
+    if (!WorldToCell(p, i, j)) return TrainHandle();
+    if (glm::distance(CellToWorld(i, j), p) >= CELL_SIZE * 0.4f) return TrainHandle();
+
+    // Open track has at most one train per cell, the one holding it
+    if (IsBlock(i, j)) {
+        int slot = blocks.Holder(i, j);
+        return slot >= 0 ? trains.HandleAt(trains.IndexOfSlot((uint32_t)slot)) : TrainHandle();
+    }
+
+    for (int k = 0; k < trains.Count(); k++)
+        if (trains.i[k] == i && trains.j[k] == j) return trains.HandleAt(k);
+    return TrainHandle();
+}
+
+int TrainSim::TrainCapacity(int k) const
+{
+    return trains.wagons[k] * 6;
+}
+
+/* =========================================================
+ *  Rail Construction and Deletion
+ * ========================================================= */
+void TrainSim::BuildRailPath(int startStationId, int endStationId)
+{
+    int si, sj, ei, ej;
+    if (!WorldToCell(stations.pos[startStationId], si, sj) ||
+        !WorldToCell(stations.pos[endStationId], ei, ej))
+    {
+        return;
+    }
+
+    std::vector<std::pair<int, int>>& path = railPath;
+    if (!pathfinder.FindPath(grid, si, sj, ei, ej, path))
+    {
+        return;
+    }
+
+    // Every step is checked against the cells changed so far, and nothing
+    // reaches the grid unless the whole path is valid
+    railEdit.Begin(grid);
+    for (int k = 0; k + 1 < (int)path.size(); k++)
+    {
+        if (!railEdit.Connect(path[k].first, path[k].second, path[k + 1].first, path[k + 1].second))
+        {
+            railEdit.Rollback();
+            return;
+        }
+    }
+
+    railEdit.Commit([this](int i, int j, unsigned char mask) { SetRailMask(i, j, mask); });
+}
+
+void TrainSim::EraseRailFromCell(int si, int sj)
+{
+    if (grid.At(si, sj).RailMask() == 0)  return;
+
+    unsigned char m = grid.At(si, sj).RailMask();
+    for (int d = 0; d < 4; d++)
+        if (m & DirToMask(d))
+            EraseRailsInDirection(si, sj, d);
+}
+
+void TrainSim::EraseRailsInDirection(int si, int sj, int dir)
+{
+    int i = si;
+    int j = sj;
+    int curDir = dir;
+    while (true)
+    {
+        if (grid.At(i, j).HasStation()) break;
+
+        SetRailMask(i, j, grid.At(i, j).RailMask() & ~DirToMask(curDir));
+
+        int ni = i + di[curDir];
+        int nj = j + dj[curDir];
+        if (!grid.InBounds(ni, nj)) break;
+
+        SetRailMask(ni, nj, grid.At(ni, nj).RailMask() & ~DirToMask(OppositeDir(curDir)));
+
+        i = ni;
+        j = nj;
+        if (grid.At(i, j).RailMask() == 0) break;
+
+        unsigned char newMask = grid.At(i, j).RailMask();
+        bool found = false;
+        for (int d = 0; d < 4; d++)
+        {
+            if (newMask & DirToMask(d))
+            {
+                curDir = d;
+                found = true;
+                break;
+            }
+        }
+
+        if (!found) break;
+    }
+}
+
+void TrainSim::RemoveTrainsOnBrokenRails()
+{
+    // Only trains inside chunks where some cell lost its last rail can be
+    // standing on a broken rail; everything else is skipped without a lookup.
+    if (brokenChunkList.empty()) return;
+
+    // Swap-remove while walking backwards: the train moved into slot k has
+    // already been checked
+    for (int k = trains.Count() - 1; k >= 0; k--)
+    {
+        if (!brokenRailChunks.At(grid.ChunkRowOf(trains.i[k]), grid.ChunkColOf(trains.j[k]))) continue;
+
+        if (grid.At(trains.i[k], trains.j[k]).RailMask() == 0) {
+            currentPoints += 10 + trains.wagons[k] * 5;
+            if (IsBlock(trains.i[k], trains.j[k])) blocks.Release(trains.i[k], trains.j[k]);
+            trains.RemoveAt(k);
+        }
+    }
+
+    for (int chunk : brokenChunkList) {
+        int chunkRow = brokenRailChunks.RowOf(chunk);
+        int chunkCol = brokenRailChunks.ColOf(chunk);
+        brokenRailChunks[chunk] = 0;
+        grid.CompactChunk(chunkRow, chunkCol);
+    }
+    brokenChunkList.clear();
+}
+
+void TrainSim::SetRailMask(int i, int j, unsigned char mask)
+{
+    const Cell& cell = grid.At(i, j);
+    if (cell.RailMask() == mask) return;
+
+    int chunkRow = grid.ChunkRowOf(i);
+    int chunkCol = grid.ChunkColOf(j);
+
+    if (cell.RailMask() == 0) {
+        chunkRailCells.At(chunkRow, chunkCol)++;
+        blocks.Reserve(i, j);
+    }
+    else if (mask == 0) {
+        chunkRailCells.At(chunkRow, chunkCol)--;
+
+        unsigned char& broken = brokenRailChunks.At(chunkRow, chunkCol);
+        if (!broken) {
+            broken = 1;
+            brokenChunkList.push_back((int)brokenRailChunks.Index(chunkRow, chunkCol));
+        }
+    }
+
+    bool removedTrack = (cell.RailMask() & ~mask) != 0;
+    grid.Edit(i, j).SetRailMask(mask);
+
+    pathfinder.InvalidateCell(i, j);
+    network.InvalidateCell(i, j, removedTrack);
+}
+
+bool TrainSim::HasRailAt(int i, int j) const
+{
+    return grid.At(i, j).RailMask() != 0;
+}
+
+bool TrainSim::StationsConnected(int a, int b)
+{
+    int ai, aj, bi, bj;
+    if (!WorldToCell(stations.pos[a], ai, aj) || !WorldToCell(stations.pos[b], bi, bj))
+        return false;
+
+    network.Sync(grid);
+    return network.Connected(ai, aj, bi, bj);
+}
+
+/* =========================================================
+ *  Snapshots
+ * ========================================================= */
+bool TrainSim::SaveSnapshot(const std::string& path) const
+{
+    bool saved = false;
+    BuildSnapshot([&](const SnapshotWriter& writer) { saved = writer.Write(path, SNAPSHOT_VERSION); });
+    return saved;
+}
+
+uint64_t TrainSim::StateHash() const
+{
+    uint64_t hash = 0;
+    BuildSnapshot([&](const SnapshotWriter& writer) { hash = writer.Hash(); });
+    return hash;
+}
+
+void TrainSim::BuildSnapshot(const std::function<void(const SnapshotWriter&)>& use) const
+{
+    SnapshotWriter writer;
+
+    SavedState state = {};
+    state.gridWidth = grid.Width();
+    state.gridHeight = grid.Height();
+    state.seed = config.seed;
+    state.sandbox = config.sandbox;
+    state.gameOver = gameOver;
+    state.shapesSeen[(int)StationShape::Circle] = circleExists;
+    state.shapesSeen[(int)StationShape::Square] = squareExists;
+    state.shapesSeen[(int)StationShape::Pyramid] = pyramidExists;
+    state.selectedStation = selectedStation;
+    state.deliveredPassengers = totalDeliveredPassengers;
+    state.points = currentPoints;
+    state.gameTime = gameTime;
+    state.eventTime = events.Now();
+    state.eventSequence = events.NextSequence();
+
+    const Random* streams[3] = { &terrainRandom, &stationRandom, &passengerRandom };
+    for (int s = 0; s < 3; s++) {
+        state.randomState[s] = streams[s]->State();
+        state.randomIncrement[s] = streams[s]->Increment();
+    }
+    writer.Add(SNAP_STATE, &state, 1);
+
+    // Dense chunks go out straight from the grid
+    std::vector<Cell> chunkValues;
+    std::vector<uint32_t> denseChunks;
+    for (int r = 0; r < grid.ChunksY(); r++) {
+        for (int c = 0; c < grid.ChunksX(); c++) {
+            const ChunkedGrid<Cell>::Chunk& chunk = grid.GetChunk(r, c);
+            chunkValues.push_back(chunk.uniform);
+            if (chunk.IsUniform()) continue;
+
+            denseChunks.push_back((uint32_t)(r * grid.ChunksX() + c));
+            writer.Add(SNAP_CELLS, chunk.cells.data(), chunk.cells.size());
+        }
+    }
+    writer.Add(SNAP_CHUNK_VALUES, chunkValues);
+    writer.Add(SNAP_DENSE_CHUNKS, denseChunks);
+
+    std::vector<SavedStation> savedStations(stations.Count());
+    for (int k = 0; k < stations.Count(); k++) {
+        SavedStation& saved = savedStations[k];
+        WorldToCell(stations.pos[k], saved.i, saved.j);
+        saved.shape = (int32_t)stations.shape[k];
+        for (int s = 0; s < SHAPE_COUNT; s++) saved.waiting[s] = stations.waiting[k].byShape[s];
+        saved.fullToken = stations.fullToken[k];
+    }
+    writer.Add(SNAP_STATIONS, savedStations);
+
+    std::vector<SavedEvent> savedEvents;
+    for (const EventScheduler::Entry& entry : events.Entries()) {
+        SavedEvent saved = {};
+        saved.time = entry.event.time;
+        saved.kind = entry.event.kind;
+        saved.id = entry.event.id;
+        saved.token = entry.event.token;
+        saved.sequence = entry.sequence;
+        savedEvents.push_back(saved);
+    }
+    writer.Add(SNAP_EVENTS, savedEvents);
+
+    writer.Add(SNAP_SLOTS, trains.Slots());
+    writer.Add(SNAP_GENERATIONS, trains.Generations());
+    writer.Add(SNAP_FREE_SLOTS, trains.FreeSlots());
+    writer.Add(SNAP_TRAIN_I, trains.i);
+    writer.Add(SNAP_TRAIN_J, trains.j);
+    writer.Add(SNAP_TRAIN_DIR, trains.dir);
+    writer.Add(SNAP_TRAIN_PROGRESS, trains.progress);
+    writer.Add(SNAP_TRAIN_MOVED, trains.moved);
+    writer.Add(SNAP_TRAIN_STOPPING, trains.stopping);
+    writer.Add(SNAP_TRAIN_WAGONS, trains.wagons);
+    writer.Add(SNAP_TRAIN_STATION, trains.stationId);
+    writer.Add(SNAP_TRAIN_TARGET, trains.target);
+    writer.Add(SNAP_TRAIN_PASSENGERS, trains.passengers);
+
+    std::vector<int32_t> trailSizes;
+    std::vector<glm::vec3> trailPoints;
+    for (const TrainTrail& trail : trains.trail) {
+        trailSizes.push_back(trail.Size());
+        for (int age = trail.Size() - 1; age >= 0; age--)
+            trailPoints.push_back(trail.PointAt(age));
+    }
+    writer.Add(SNAP_TRAIL_SIZES, trailSizes);
+    writer.Add(SNAP_TRAIL_POINTS, trailPoints);
+
+    use(writer);
+}
+
+bool TrainSim::LoadSnapshot(const std::string& path)
+{
+    SnapshotReader reader;
+    if (!reader.Open(path, SNAPSHOT_VERSION)) return false;
+
+    // ***** VALIDATION *****
+    // Everything is checked before the game is touched
+    const SavedState* state;
+    size_t count;
+    if (!reader.Find(SNAP_STATE, state, count) || count != 1) return false;
+
+    int width = state->gridWidth;
+    int height = state->gridHeight;
+    if (width < MIN_GRID_SIZE || width > MAX_GRID_SIZE || height < MIN_GRID_SIZE || height > MAX_GRID_SIZE)
+        return false;
+
+    ChunkedGrid<Cell> loaded;
+    loaded.Assign(width, height);
+    size_t chunkCount = (size_t)loaded.ChunksX() * loaded.ChunksY();
+
+    const Cell* chunkValues;
+    const uint32_t* denseChunks;
+    const Cell* cells = nullptr;
+    size_t denseCount, cellCount = 0;
+    if (!reader.Find(SNAP_CHUNK_VALUES, chunkValues, count) || count != chunkCount) return false;
+    if (!reader.Find(SNAP_DENSE_CHUNKS, denseChunks, denseCount)) return false;
+    if (!reader.Find(SNAP_CELLS, cells, cellCount) && denseCount > 0) return false;
+    if (cellCount != denseCount * ChunkedGrid<Cell>::CHUNK_CELLS) return false;
+
+    // The grid is built aside, so the checks below can look at its cells
+    for (size_t k = 0; k < chunkCount; k++)
+        loaded.EditChunk((int)(k / loaded.ChunksX()), (int)(k % loaded.ChunksX())).uniform = chunkValues[k];
+    for (size_t k = 0; k < denseCount; k++) {
+        if (denseChunks[k] >= chunkCount) return false;
+
+        ChunkedGrid<Cell>::Chunk& chunk = loaded.EditChunk(denseChunks[k] / loaded.ChunksX(), denseChunks[k] % loaded.ChunksX());
+        if (!chunk.IsUniform()) return false;
+
+        const Cell* chunkCells = cells + k * ChunkedGrid<Cell>::CHUNK_CELLS;
+        chunk.cells.assign(chunkCells, chunkCells + ChunkedGrid<Cell>::CHUNK_CELLS);
+    }
+
+    // One station per station cell, and the other way round
+    const SavedStation* savedStations;
+    size_t stationCount;
+    if (!reader.Find(SNAP_STATIONS, savedStations, stationCount)) return false;
+
+    std::vector<size_t> stationCells(stationCount);
+    for (size_t k = 0; k < stationCount; k++) {
+        const SavedStation& saved = savedStations[k];
+        if (!loaded.InBounds(saved.i, saved.j) || saved.shape < 0 || saved.shape >= SHAPE_COUNT) return false;
+        if (!loaded.At(saved.i, saved.j).HasStation()) return false;
+        for (int s = 0; s < SHAPE_COUNT; s++)
+            if (saved.waiting[s] < 0) return false;
+        stationCells[k] = (size_t)saved.i * width + saved.j;
+    }
+    std::sort(stationCells.begin(), stationCells.end());
+    if (std::adjacent_find(stationCells.begin(), stationCells.end()) != stationCells.end()) return false;
+
+    size_t flaggedCells = 0;
+    for (int i = 0; i < height; i++)
+        for (int c = 0; c < loaded.ChunksX(); c++)
+            flaggedCells += PopCount(MatchChunkRow(loaded, i, c, CELL_STATION, CELL_STATION));
+    if (flaggedCells != stationCount) return false;
+
+    const SavedEvent* savedEvents;
+    size_t eventCount;
+    if (!reader.Find(SNAP_EVENTS, savedEvents, eventCount)) return false;
+    for (size_t k = 0; k < eventCount; k++) {
+        const SavedEvent& saved = savedEvents[k];
+        if (saved.kind < (int)SimEvent::StationSpawn || saved.kind > (int)SimEvent::StationStop) return false;
+        if (saved.kind == (int)SimEvent::StationFull && (saved.id < 0 || saved.id >= (int)stationCount)) return false;
+    }
+
+    const uint32_t* slots;
+    const uint32_t* generations;
+    const uint32_t* freeSlots;
+    size_t trainCount, slotCount, freeCount;
+    if (!reader.Find(SNAP_SLOTS, slots, trainCount) ||
+        !reader.Find(SNAP_GENERATIONS, generations, slotCount) ||
+        !reader.Find(SNAP_FREE_SLOTS, freeSlots, freeCount))
+    {
+        return false;
+    }
+
+    // Every per-train section has one record per train
+    const int* ti;
+    const int* tj;
+    const int* tdir;
+    const float* progress;
+    const float* moved;
+    const unsigned char* stopping;
+    const int* wagons;
+    const int* stationId;
+    const int* target;
+    const PassengerCounts* passengers;
+    const int32_t* trailSizes;
+    const glm::vec3* trailPoints;
+    size_t sizes[11], pointCount;
+    bool found =
+        reader.Find(SNAP_TRAIN_I, ti, sizes[0]) && reader.Find(SNAP_TRAIN_J, tj, sizes[1]) &&
+        reader.Find(SNAP_TRAIN_DIR, tdir, sizes[2]) && reader.Find(SNAP_TRAIN_PROGRESS, progress, sizes[3]) &&
+        reader.Find(SNAP_TRAIN_MOVED, moved, sizes[4]) && reader.Find(SNAP_TRAIN_STOPPING, stopping, sizes[5]) &&
+        reader.Find(SNAP_TRAIN_WAGONS, wagons, sizes[6]) && reader.Find(SNAP_TRAIN_STATION, stationId, sizes[7]) &&
+        reader.Find(SNAP_TRAIN_TARGET, target, sizes[8]) && reader.Find(SNAP_TRAIN_PASSENGERS, passengers, sizes[9]) &&
+        reader.Find(SNAP_TRAIL_SIZES, trailSizes, sizes[10]) && reader.Find(SNAP_TRAIL_POINTS, trailPoints, pointCount);
+    if (!found) return false;
+    for (size_t size : sizes)
+        if (size != trainCount) return false;
+
+    // Trains stand on track, and at most one on each cell of open track,
+    // as BlockSignals has it. Out on the line a train always leaves by
+    // dir; at a station it may still face the way it came in.
+    std::vector<size_t> blockCells;
+    size_t totalPoints = 0;
+    for (size_t k = 0; k < trainCount; k++) {
+        if (!loaded.InBounds(ti[k], tj[k]) || tdir[k] < 0 || tdir[k] > 3) return false;
+
+        const Cell& cell = loaded.At(ti[k], tj[k]);
+        if (cell.RailMask() == 0) return false;
+        if (!cell.HasStation()) {
+            if (!(cell.RailMask() & DirToMask(tdir[k]))) return false;
+            blockCells.push_back((size_t)ti[k] * width + tj[k]);
+        }
+
+        if (wagons[k] < 0 || wagons[k] > MAX_WAGONS || trailSizes[k] < 0) return false;
+        if (stationId[k] < -1 || stationId[k] >= (int)stationCount) return false;
+        if (target[k] < -1 || target[k] >= (int)stationCount) return false;
+        if (stopping[k] && stationId[k] < 0) return false;
+        if (!ValidPassengers(passengers[k])) return false;
+
+        // Written as a range test so NaN fails it too
+        if (!(progress[k] >= 0.0f && progress[k] <= 1.0f)) return false;
+        if (!(moved[k] >= 0.0f && moved[k] <= 1.0f)) return false;
+        totalPoints += trailSizes[k];
+    }
+    if (totalPoints != pointCount) return false;
+
+    std::sort(blockCells.begin(), blockCells.end());
+    if (std::adjacent_find(blockCells.begin(), blockCells.end()) != blockCells.end()) return false;
+
+    if (!trains.Restore(slots, (int)trainCount, generations, (int)slotCount, freeSlots, (int)freeCount))
+        return false;
+
+    // ***** GAME STATE *****
+    config.gridWidth = width;
+    config.gridHeight = height;
+    config.seed = state->seed;
+    config.sandbox = state->sandbox != 0;
+    gameOver = state->gameOver != 0;
+    circleExists = state->shapesSeen[(int)StationShape::Circle] != 0;
+    squareExists = state->shapesSeen[(int)StationShape::Square] != 0;
+    pyramidExists = state->shapesSeen[(int)StationShape::Pyramid] != 0;
+    selectedStation = state->selectedStation >= 0 && state->selectedStation < (int)stationCount ? state->selectedStation : -1;
+    totalDeliveredPassengers = state->deliveredPassengers;
+    currentPoints = state->points;
+    gameTime = state->gameTime;
+
+    Random* streams[3] = { &terrainRandom, &stationRandom, &passengerRandom };
+    for (int s = 0; s < 3; s++)
+        streams[s]->Restore(state->randomState[s], state->randomIncrement[s]);
+
+    std::vector<EventScheduler::Entry> entries(eventCount);
+    for (size_t k = 0; k < eventCount; k++) {
+        entries[k].event.time = savedEvents[k].time;
+        entries[k].event.kind = savedEvents[k].kind;
+        entries[k].event.id = savedEvents[k].id;
+        entries[k].event.token = savedEvents[k].token;
+        entries[k].sequence = savedEvents[k].sequence;
+    }
+    events.Restore(state->eventTime, state->eventSequence, entries.data(), (int)eventCount);
+
+    // ***** GRID *****
+    grid = std::move(loaded);
+
+    // Everything derived from the grid is rebuilt as for a new map, then
+    // told about the rail already on it
+    stationIndex.Assign(width, height, -1);
+    stationSites.Build(grid);
+    chunkRailCells.Assign(grid.ChunksX(), grid.ChunksY(), 0);
+    brokenRailChunks.Assign(grid.ChunksX(), grid.ChunksY(), 0);
+    brokenChunkList.clear();
+    railPath.clear();
+    pathfinder.Reset(width, height);
+    network.Reset(width, height);
+    routes.Reset();
+    blocks.Reset(width, height);
+
+    for (int i = 0; i < height; i++) {
+        for (int c = 0; c < grid.ChunksX(); c++) {
+            uint64_t rails = RailCells(grid, i, c);
+            if (rails) chunkRailCells.At(grid.ChunkRowOf(i), c) += PopCount(rails);
+
+            for (; rails; rails &= rails - 1) {
+                int j = c * ChunkedGrid<Cell>::CHUNK_SIZE + LowestBit(rails);
+                network.InvalidateCell(i, j);
+                blocks.Reserve(i, j);
+            }
+        }
+    }
+
+    // ***** STATIONS *****
+    stations.Clear();
+    for (size_t k = 0; k < stationCount; k++) {
+        const SavedStation& saved = savedStations[k];
+
+        int id = stations.Add(CellToWorld(saved.i, saved.j), (StationShape)saved.shape);
+        for (int s = 0; s < SHAPE_COUNT; s++) stations.waiting[id].Add((StationShape)s, saved.waiting[s]);
+        stations.fullToken[id] = saved.fullToken;
+
+        stationIndex.Set(saved.i, saved.j, id);
+        stationSites.Exclude(saved.i, saved.j);
+    }
+
+    // ***** TRAINS *****
+    // Cursors point into the old network, so trains find their edge again
+    // from their cell on the next step
+    trains.i.assign(ti, ti + trainCount);
+    trains.j.assign(tj, tj + trainCount);
+    trains.dir.assign(tdir, tdir + trainCount);
+    trains.progress.assign(progress, progress + trainCount);
+    trains.moved.assign(moved, moved + trainCount);
+    trains.stopping.assign(stopping, stopping + trainCount);
+    trains.wagons.assign(wagons, wagons + trainCount);
+    trains.stationId.assign(stationId, stationId + trainCount);
+    trains.target.assign(target, target + trainCount);
+    trains.passengers.assign(passengers, passengers + trainCount);
+    trainPending.clear();
+
+    const glm::vec3* point = trailPoints;
+    for (int k = 0; k < (int)trainCount; k++) {
+        FitTrainTrail(k);
+        if (trailSizes[k] == 0) ResetTrainTrail(k);
+        for (int p = 0; p < trailSizes[k]; p++, point++) {
+            if (p == 0) trains.trail[k].Reset(*point);
+            else trains.trail[k].Push(*point);
+        }
+
+        if (IsBlock(trains.i[k], trains.j[k])) blocks.Hold(trains.i[k], trains.j[k], trains.HandleAt(k).slot);
+    }
+
+    return true;
+}
+
+/* =========================================================
+ *  Game Restart
+ * ========================================================= */
+void TrainSim::RestartGame()
+{
+    grid.Clear();
+    trains.Clear();
+    stations.Clear();
+    selectedStation = -1;
+    gameOver = circleExists = squareExists = pyramidExists = false;
+    totalDeliveredPassengers = 0;
+    currentPoints = 15;
+    gameTime = 0;
+
+    events.Clear();
+    events.Schedule(stationSpawnInterval, (int)SimEvent::StationSpawn, 0);
+    events.Schedule(passengerSpawnInterval, (int)SimEvent::PassengerSpawn, 0);
+
+    InitGrid();
+
+    SpawnRandomStation();
+    SpawnRandomStation();
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "lab_m1/tema2/sim/block_signals.h"
+#include "lab_m1/tema2/sim/chunked_grid.h"
+#include "lab_m1/tema2/sim/event_scheduler.h"
+#include "lab_m1/tema2/sim/grid.h"
+#include "lab_m1/tema2/sim/hierarchical_pathfinder.h"
+#include "lab_m1/tema2/sim/rail_edit.h"
+#include "lab_m1/tema2/sim/rail_network.h"
+#include "lab_m1/tema2/sim/random.h"
+#include "lab_m1/tema2/sim/route_cache.h"
+#include "lab_m1/tema2/sim/sim_types.h"
+#include "lab_m1/tema2/sim/station_sites.h"
+#include "lab_m1/tema2/sim/station_store.h"
+#include "lab_m1/tema2/sim/terrain_generator.h"
+#include "lab_m1/tema2/sim/thread_pool.h"
+#include "lab_m1/tema2/sim/train_store.h"
+
+
+namespace m1
+{
+    class SnapshotWriter;
+
+    struct SimConfig
+    {
+        // Player actions cost no points and full stations never end the game.
+        // Used by the headless runner to build large load-test networks.
+        bool sandbox = false;
+
+        // Map size in cells, chosen at runtime.
+        int gridWidth = 16;
+        int gridHeight = 16;
+
+        // Terrain costs used when routing new track between stations.
+        PathCosts pathCosts;
+
+        // Noise and optional heightmap the map terrain is generated from.
+        TerrainSettings terrain;
+
+        // Threads for the train update, 0 for one per hardware thread. The
+        // result does not depend on this value.
+        int threads = 1;
+
+        // Seeds every random stream. The same seed and the same player
+        // actions give the same game.
+        unsigned int seed = 1;
+    };
+
+    // Game logic of the train game, without any rendering or windowing
+    // dependency. TrainGame drives it once per frame; the headless runner
+    // drives it as fast as the CPU allows.
+    class TrainSim
+    {
+    public:
+        TrainSim();
+        ~TrainSim();
+
+        void Init(const SimConfig& config = SimConfig());
+        void Tick(float dt);
+        void RestartGame();
+
+        // ===== PLAYER ACTIONS =====
+        void HandleStationConnection(const glm::vec3& hit);
+        bool AddWagon(TrainHandle train);
+        TrainHandle PlaceTrainAt(int i, int j);
+        bool EraseRailsAt(int i, int j);
+
+        // Runs a recorded action. Returns the train it placed or gave a
+        // wagon to, an invalid handle otherwise.
+        TrainHandle Perform(const PlayerAction& action);
+
+        // ===== SNAPSHOTS =====
+        // The whole game, see snapshot.h. Loading keeps the thread count and
+        // the settings only used to generate new maps; on failure the game
+        // is left as it was.
+        bool SaveSnapshot(const std::string& path) const;
+        bool LoadSnapshot(const std::string& path);
+
+        // Hash of everything SaveSnapshot stores: cells, stations, trains,
+        // pending events, random streams, points and time. The rail network
+        // and routes are rebuilt from the cells, so two games with the same
+        // hash play on the same.
+        uint64_t StateHash() const;
+
+        // ===== QUERIES =====
+        glm::vec3 CellToWorld(int i, int j) const;
+        bool WorldToCell(const glm::vec3& p, int& i, int& j) const;
+        int PickStationAt(const glm::vec3& p) const;
+        TrainHandle PickGridTrainAt(const glm::vec3& p) const;
+        bool HasRailAt(int i, int j) const;
+        bool StationsConnected(int a, int b);
+
+        int GridWidth() const { return grid.Width(); }
+        int GridHeight() const { return grid.Height(); }
+        const ChunkedGrid<Cell>& GetGrid() const { return grid; }
+        int GetChunkRailCells(int chunkRow, int chunkCol) const { return chunkRailCells.At(chunkRow, chunkCol); }
+        const Cell& GetCell(int i, int j) const { return grid.At(i, j); }
+        const StationStore& GetStations() const { return stations; }
+        const TrainStore& GetTrains() const { return trains; }
+        const RailNetwork& GetRailNetwork() const { return network; }
+        bool UsesHeightmap() const { return terrain.HasHeightmap(); }
+
+        bool IsGameOver() const { return gameOver; }
+        double GetGameTime() const { return gameTime; }
+        int GetPoints() const { return currentPoints; }
+        int GetDeliveredPassengers() const { return totalDeliveredPassengers; }
+        int GetSelectedStation() const { return selectedStation; }
+        int TrainCapacity(int train) const;
+        glm::vec3 GetTrainPos(int train) const;
+        glm::vec3 GetTrainDir(int train) const;
+
+        static constexpr float CELL_SIZE = 1.0f;
+        static constexpr float TRAIN_Y_OFFSET = 0.07f;
+        static constexpr int MIN_GRID_SIZE = 8;
+        static constexpr int MAX_GRID_SIZE = 4096;
+
+        // Train layout along its trail, in world units
+        static constexpr float LOCOMOTIVE_LENGTH = 1.35f;
+        static constexpr float WAGON_SPACING = 1.15f;
+        static constexpr int MAX_WAGONS = 5;
+
+        // Points a new train and an extra wagon cost outside sandbox
+        static constexpr int TRAIN_COST = 15;
+        static constexpr int WAGON_COST = 5;
+        static constexpr float TRAIN_SPEED = 2.0f;  // cells per second
+
+    protected:
+        SimConfig config;
+
+        // ===== GRID =====
+        ChunkedGrid<Cell> grid;
+        Grid<int> chunkRailCells;
+        Grid<unsigned char> brokenRailChunks;
+        std::vector<int> brokenChunkList;
+
+        // Station id per cell, -1 where there is none. Kept chunked so maps
+        // with few stations cost one value per empty chunk.
+        ChunkedGrid<int> stationIndex;
+
+        // Cells a new station may still be placed on
+        StationSites stationSites;
+
+        TerrainGenerator terrain;
+
+        // ===== PATHFINDING =====
+        HierarchicalPathfinder pathfinder;
+        std::vector<std::pair<int, int>> railPath;
+        RailEdit railEdit;
+
+        // ===== RAIL NETWORK =====
+        RailNetwork network;
+        RouteCache routes;
+        std::vector<unsigned char> targetedStations;
+
+        void InitGrid();
+        void SetRailMask(int i, int j, unsigned char mask);
+
+        // ===== GAME DATA =====
+        StationStore stations;
+        TrainStore trains;
+
+        // ===== TRAIN UPDATE =====
+        // Work a train could not finish without touching station state.
+        // The parallel pass leaves it here and the serial pass completes it
+        // in train order.
+        enum class TrainPending : unsigned char {
+            None,
+            Arrival,
+            Stopped,
+            Entry,      // claimed the next cell, see BlockSignals
+            Blocked     // lost it to another train
+        };
+
+        static constexpr int PARALLEL_MIN_TRAINS = 256;
+
+        ThreadPool workers;
+        std::vector<TrainPending> trainPending;
+
+        // Cell under each locomotive, so no two trains share a cell of open
+        // track. Stations are platforms any number of trains can stand at;
+        // queueing for one would leave a train's followers to arrive only
+        // once it has taken the passengers.
+        BlockSignals blocks;
+
+        bool IsBlock(int i, int j) const { return !grid.At(i, j).HasStation(); }
+
+        // ===== RANDOM =====
+        // One stream per consumer, so drawing more from one of them never
+        // shifts what the others produce. Parallel jobs use WorkRandom.
+        enum RandomStream : uint64_t {
+            TERRAIN_STREAM,
+            STATION_STREAM,
+            PASSENGER_STREAM,
+            WORK_STREAM_BASE = 1 << 16
+        };
+
+        Random terrainRandom;
+        Random stationRandom;
+        Random passengerRandom;
+
+        // Stream for one item of parallel work, e.g. a chunk or a row
+        Random WorkRandom(int item) const { return Random(config.seed, WORK_STREAM_BASE + (uint64_t)item); }
+
+        // ===== EVENTS =====
+        enum class SimEvent : int {
+            StationSpawn,
+            PassengerSpawn,
+            StationFull,    // id = station, token = its fullToken
+            StationStop     // id = train slot, token = its generation
+        };
+
+        EventScheduler events;
+
+        float stationMaxFullnessTimer = 30.0f; // 30.0f
+        float stationStopInterval = 0.5f;
+
+        bool gameOver, circleExists, squareExists, pyramidExists;
+        int selectedStation;
+        float pickRadius = 0.75f; // must stay below CELL_SIZE, see PickStationAt
+        int di[4] = { -1, 0, 1, 0 };
+        int dj[4] = { 0, 1, 0, -1 };
+        float stationSpawnInterval = 30.0f; // 30.0f
+        float passengerSpawnInterval = 8.0f; // 8.0f
+
+        // Summed in double, like EventScheduler time: a float drifts by
+        // seconds over a long run of fixed steps
+        double gameTime;
+        int totalDeliveredPassengers;
+        int currentPoints;
+
+        // ===== HELPERS AND FUNCTIONS =====
+        void AddStation(const glm::vec3& pos, StationShape shape);
+        bool SpawnRandomStation();
+        void SpawnPassengers();
+        TrainHandle SpawnTrainAtCell(int i, int j);
+        int ChooseNextDirection(int i, int j, int comingFromDir) const;
+        int StationAtNode(int node) const;
+        void HandleEvent(const EventScheduler::Event& event);
+        void ScheduleStationStop(int train);
+        void UpdateGridTrains(float dt);
+        void EraseRailsInDirection(int si, int sj, int dir);
+        void EraseRailFromCell(int si, int sj);
+        void RemoveTrainsOnBrokenRails();
+        int GetStationAtCell(int i, int j) const;
+        // Train helpers take the dense index into trains
+        TrainPending AdvanceTrain(int train, float dt);
+        void FinishTrain(int train, TrainPending pending);
+        TrainPending RequestBlock(int train);
+        TrainPending EnterBlock(int train);
+        bool ArriveTrain(int train, bool shared);
+        void ResolveBlock(int train);
+        int ReverseDir(int i, int j, int dir) const;
+        void StartStationStop(int train, int stationId);
+        void ProcessStationPassengers(int train);
+        void ResetTrainTrail(int train);
+        void UpdateTrainTrail(int train);
+        void FitTrainTrail(int train);
+        void ChooseTrainTarget(int train, int atStation);
+        int TrainExitDir(int train, bool mayReverse) const;
+        void BuildRailPath(int startStationId, int endStationId);
+
+        // Hands a writer holding the whole game to use, for saving or hashing
+        void BuildSnapshot(const std::function<void(const SnapshotWriter&)>& use) const;
+    };
+}
@@ -0,0 +1,160 @@
+#include "lab_m1/tema2/sim/train_store.h"
+
+#include <utility>
+
+using namespace std;
+using namespace m1;
+
+
+namespace
+{
+    template <typename T>
+    void MoveLast(std::vector<T>& v, int index)
+    {
+        if (index != (int)v.size() - 1) v[index] = std::move(v.back());
+        v.pop_back();
+    }
+}
+
+
+TrainHandle TrainStore::Add()
+{
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        slot = (uint32_t)indexOf.size();
+        indexOf.push_back(-1);
+        generations.push_back(0);
+    }
+
+    indexOf[slot] = Count();
+    slotOf.push_back(slot);
+
+    i.push_back(0);
+    j.push_back(0);
+    dir.push_back(0);
+    progress.push_back(0.0f);
+    moved.push_back(0.0f);
+    cursor.push_back(RailCursor());
+    stopping.push_back(0);
+
+    wagons.push_back(0);
+    stationId.push_back(-1);
+    target.push_back(-1);
+    passengers.push_back(PassengerCounts());
+
+    trail.push_back(TrainTrail());
+
+    TrainHandle handle;
+    handle.slot = slot;
+    handle.generation = generations[slot];
+    return handle;
+}
+
+void TrainStore::RemoveAt(int index)
+{
+    uint32_t slot = slotOf[index];
+    uint32_t lastSlot = slotOf.back();
+
+    indexOf[lastSlot] = index;
+    indexOf[slot] = -1;
+    generations[slot]++;
+    freeSlots.push_back(slot);
+
+    MoveLast(slotOf, index);
+
+    MoveLast(i, index);
+    MoveLast(j, index);
+    MoveLast(dir, index);
+    MoveLast(progress, index);
+    MoveLast(moved, index);
+    MoveLast(cursor, index);
+    MoveLast(stopping, index);
+
+    MoveLast(wagons, index);
+    MoveLast(stationId, index);
+    MoveLast(target, index);
+    MoveLast(passengers, index);
+
+    MoveLast(trail, index);
+}
+
+void TrainStore::Clear()
+{
+    // Bump every live slot so handles from before the clear stay invalid
+    for (uint32_t slot : slotOf) {
+        indexOf[slot] = -1;
+        generations[slot]++;
+        freeSlots.push_back(slot);
+    }
+    slotOf.clear();
+
+    i.clear();
+    j.clear();
+    dir.clear();
+    progress.clear();
+    moved.clear();
+    cursor.clear();
+    stopping.clear();
+
+    wagons.clear();
+    stationId.clear();
+    target.clear();
+    passengers.clear();
+
+    trail.clear();
+}
+
+bool TrainStore::Restore(const uint32_t* slots, int count, const uint32_t* savedGenerations, int slotCount,
+    const uint32_t* savedFreeSlots, int freeCount)
+{
+    if (count + freeCount != slotCount) return false;
+
+    std::vector<unsigned char> used(slotCount, 0);
+    std::vector<int> index(slotCount, -1);
+    for (int k = 0; k < count + freeCount; k++) {
+        uint32_t slot = k < count ? slots[k] : savedFreeSlots[k - count];
+        if (slot >= (uint32_t)slotCount || used[slot]) return false;
+        used[slot] = 1;
+        if (k < count) index[slot] = k;
+    }
+
+    indexOf.swap(index);
+    slotOf.assign(slots, slots + count);
+    generations.assign(savedGenerations, savedGenerations + slotCount);
+    freeSlots.assign(savedFreeSlots, savedFreeSlots + freeCount);
+
+    i.assign(count, 0);
+    j.assign(count, 0);
+    dir.assign(count, 0);
+    progress.assign(count, 0.0f);
+    moved.assign(count, 0.0f);
+    cursor.assign(count, RailCursor());
+    stopping.assign(count, 0);
+
+    wagons.assign(count, 0);
+    stationId.assign(count, -1);
+    target.assign(count, -1);
+    passengers.assign(count, PassengerCounts());
+
+    trail.assign(count, TrainTrail());
+    return true;
+}
+
+int TrainStore::Find(TrainHandle handle) const
+{
+    if (handle.slot >= indexOf.size()) return -1;
+    if (generations[handle.slot] != handle.generation) return -1;
+    return indexOf[handle.slot];
+}
+
+TrainHandle TrainStore::HandleAt(int index) const
+{
+    TrainHandle handle;
+    handle.slot = slotOf[index];
+    handle.generation = generations[handle.slot];
+    return handle;
+}
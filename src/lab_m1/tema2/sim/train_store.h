@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "lab_m1/tema2/sim/sim_types.h"
+#include "lab_m1/tema2/sim/train_trail.h"
+
+
+namespace m1
+{
+    // Names a train for as long as it exists. Once the train is removed its
+    // slot gets a new generation, so old handles stop resolving instead of
+    // pointing at whichever train reuses the slot.
+    struct TrainHandle
+    {
+        uint32_t slot = UINT32_MAX;
+        uint32_t generation = 0;
+
+        bool operator==(const TrainHandle& other) const
+        {
+            return slot == other.slot && generation == other.generation;
+        }
+        bool operator!=(const TrainHandle& other) const { return !(*this == other); }
+    };
+
+    // Trains stored as one array per field, indexed 0..Count()-1. The update
+    // loop streams through the small hot fields; the heap-owning trails sit
+    // in their own array and are only touched when needed. Removing a train
+    // moves the last one into its place, so dense indices change and
+    // anything kept across frames must hold a handle.
+    class TrainStore
+    {
+    public:
+        int Count() const { return (int)i.size(); }
+        bool Empty() const { return i.empty(); }
+
+        TrainHandle Add();
+        void RemoveAt(int index);
+        void Clear();
+
+        // Dense index of a live train, -1 for stale or invalid handles
+        int Find(TrainHandle handle) const;
+        TrainHandle HandleAt(int index) const;
+
+        // Dense index of the train in a slot, -1 when the slot is free
+        int IndexOfSlot(uint32_t slot) const { return indexOf[slot]; }
+
+        // ===== SNAPSHOTS =====
+        const std::vector<uint32_t>& Slots() const { return slotOf; }
+        const std::vector<uint32_t>& Generations() const { return generations; }
+        const std::vector<uint32_t>& FreeSlots() const { return freeSlots; }
+
+        // Replaces every train with count default ones in the given slots,
+        // for the caller to fill in. False, with nothing changed, unless
+        // live and free slots cover every slot exactly once.
+        bool Restore(const uint32_t* slots, int count, const uint32_t* savedGenerations, int slotCount,
+            const uint32_t* savedFreeSlots, int freeCount);
+
+        // ===== HOT =====
+        std::vector<int> i, j;
+        std::vector<int> dir;
+        std::vector<float> progress;
+        std::vector<float> moved;               // distance covered last tick
+        std::vector<RailCursor> cursor;
+        std::vector<unsigned char> stopping;
+
+        // ===== WARM =====
+        std::vector<int> wagons;
+        std::vector<int> stationId;
+        std::vector<int> target;                // station it is heading to, -1 for none
+        std::vector<PassengerCounts> passengers;
+
+        // ===== COLD =====
+        std::vector<TrainTrail> trail;
+
+    private:
+        std::vector<uint32_t> slotOf;           // per dense index
+        std::vector<int> indexOf;               // per slot, -1 when free
+        std::vector<uint32_t> generations;      // per slot
+        std::vector<uint32_t> freeSlots;
+    };
+}
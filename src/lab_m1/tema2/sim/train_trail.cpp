@@ -0,0 +1,118 @@
+#include "lab_m1/tema2/sim/train_trail.h"
+
+using namespace std;
+using namespace m1;
+
+
+namespace
+{
+    // Arc lengths are rebased once they grow past this, so float precision
+    // does not degrade on trains that run for hours
+    const float MAX_ARC = 4096.0f;
+}
+
+
+TrainTrail::TrainTrail()
+{
+    newest = 0;
+    count = 0;
+}
+
+void TrainTrail::SetCapacity(int capacity)
+{
+    if (capacity < 2) capacity = 2;
+    if (capacity == (int)points.size()) return;
+
+    // Keep the newest points, oldest first
+    std::vector<Point> resized(capacity);
+    int kept = count < capacity ? count : capacity;
+    for (int age = kept - 1, k = 0; age >= 0; age--, k++)
+        resized[k] = Back(age);
+
+    points.swap(resized);
+    count = kept;
+    newest = kept > 0 ? kept - 1 : 0;
+}
+
+void TrainTrail::Reset(const glm::vec3& pos)
+{
+    if (points.empty()) SetCapacity(2);
+
+    newest = 0;
+    count = 1;
+    points[0].pos = pos;
+    points[0].arc = 0.0f;
+}
+
+void TrainTrail::Push(const glm::vec3& pos)
+{
+    if (count == 0) {
+        Reset(pos);
+        return;
+    }
+
+    Point point;
+    point.pos = pos;
+    point.arc = points[newest].arc + glm::distance(pos, points[newest].pos);
+
+    newest++;
+    if (newest == (int)points.size()) newest = 0;
+    points[newest] = point;
+    if (count < (int)points.size()) count++;
+
+    if (point.arc > MAX_ARC) Rebase();
+}
+
+void TrainTrail::Rebase()
+{
+    float base = Back(count - 1).arc;
+    for (int age = 0; age < count; age++) {
+        int index = newest - age;
+        if (index < 0) index += (int)points.size();
+        points[index].arc -= base;
+    }
+}
+
+bool TrainTrail::At(const glm::vec3& head, float distance, glm::vec3& pos, glm::vec3& dir) const
+{
+    if (count == 0) return false;
+
+    // Step 0 runs from the newest point to the head, step n > 0 from the
+    // point of age n to the one of age n - 1
+    float headArc = points[newest].arc + glm::distance(head, points[newest].pos);
+    if (headArc - Back(count - 1).arc < distance) return false;
+
+    int step = 0;
+    if (headArc - points[newest].arc < distance) {
+        // Smallest age whose point lies at least distance behind the head;
+        // the distance behind grows with age
+        int lo = 1, hi = count - 1;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (headArc - Back(mid).arc >= distance) hi = mid;
+            else lo = mid + 1;
+        }
+        step = lo;
+    }
+
+    const Point& older = Back(step);
+    glm::vec3 newer = step == 0 ? head : Back(step - 1).pos;
+    float newerArc = step == 0 ? headArc : Back(step - 1).arc;
+    float segment = newerArc - older.arc;
+
+    float t = segment > 0.0f ? (headArc - distance - older.arc) / segment : 0.0f;
+    if (t < 0.0f) t = 0.0f;
+    pos = glm::mix(older.pos, newer, t);
+
+    // Direction of the nearest step that actually moved
+    for (; step < count; step++) {
+        glm::vec3 from = Back(step).pos;
+        glm::vec3 to = step == 0 ? head : Back(step - 1).pos;
+        float length = glm::distance(from, to);
+        if (length > 1e-6f) {
+            dir = (to - from) / length;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+
+namespace m1
+{
+    // Path a locomotive has travelled, used to place its wagons behind it.
+    // Trains move in straight lines between cell centres, so the path is
+    // fully described by the centres they passed through: one point is
+    // pushed per cell entered instead of one per frame. Points live in a
+    // ring buffer sized from the train length, so pushing never allocates
+    // and the memory does not depend on the frame rate.
+    //
+    // Every point stores the arc length travelled up to it, so the spot a
+    // given distance behind the head is found with a binary search.
+    class TrainTrail
+    {
+    public:
+        TrainTrail();
+
+        // Number of points kept; older ones are overwritten
+        void SetCapacity(int capacity);
+
+        void Reset(const glm::vec3& pos);
+        void Push(const glm::vec3& pos);
+
+        int Size() const { return count; }
+        int Capacity() const { return (int)points.size(); }
+
+        // Point pushed age steps before the newest one
+        const glm::vec3& PointAt(int age) const { return Back(age).pos; }
+
+        // Spot distance units behind head along the trail, and the direction
+        // of travel there. head is the current position, somewhere past the
+        // newest point. Fails when the trail is not that long or has not
+        // moved yet.
+        bool At(const glm::vec3& head, float distance, glm::vec3& pos, glm::vec3& dir) const;
+
+    private:
+        struct Point
+        {
+            glm::vec3 pos;
+            float arc;
+        };
+
+        const Point& Back(int age) const
+        {
+            int index = newest - age;
+            if (index < 0) index += (int)points.size();
+            return points[index];
+        }
+
+        void Rebase();
+
+        std::vector<Point> points;
+        int newest;
+        int count;
+    };
+}
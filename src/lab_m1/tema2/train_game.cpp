@@ -1,7 +1,12 @@
 #include "train_game.h"
 
 #include <iostream>
+#include <iomanip>
 #include <algorithm>
+#include <ctime>
+
+#include "lab_m1/tema2/sim/bit_plane.h"
+#include "lab_m1/tema2/sim/cell_board.h"
 
 using namespace std;
 using namespace m1;
@@ -89,137 +94,20 @@ void TrainGame::Init()
     // end
 
     // game Init
-    int di[4] = { -1, 0, 1, 0 };
-    int dj[4] = { 0, 1, 0, -1 };
-
-    grid.clear();
-    gridTrains.clear();
-    stations.clear();
-    stationFullnessTimers.clear();
-    selectedStation = -1;
-    gameOver = circleExists = squareExists = pyramidExists = false;
-    totalDeliveredPassengers = 0;
-    currentPoints = 15;
-    gameTime = 0.0f;
-
     auto resolution = window->GetResolution();
     textRenderer = new gfxc::TextRenderer(window->props.selfDir, resolution.x, resolution.y);
     textRenderer->Load(PATH_JOIN(window->props.selfDir, RESOURCE_PATH::FONTS, "Hack-Bold.ttf"), 48);
     // end
 
-    // Grid Init
-    InitGrid();
-
-    SpawnRandomStation();
-    SpawnRandomStation();
-    // end
-}
-
-/* =========================================================
- *  Grid init
- * ========================================================= */
-void TrainGame::InitGrid()
-{
-    grid.assign(GRID_H, std::vector<Cell>(GRID_W));
-
-    // Grass
-    for (int i = 0; i < GRID_H; i++) {
-        for (int j = 0; j < GRID_W; j++) {
-            grid[i][j].type = CellType::Grass;
-            grid[i][j].hasStation = false;
-        }
-    }
-    // end
-
-    // River
-    int i = GRID_H / 2;
-    int j = 0;
-    while (j < GRID_W) {
-        grid[i][j].type = CellType::Water;
-        grid[i - 1][j].type = CellType::Water;
-        grid[i + 1][j].type = CellType::Water;
-
-        int dirChance = rand() % 3;
-        if (dirChance == 0 && i > 1) i--;
-        else if (dirChance == 2 && i < GRID_H - 2) i++;
-
-        j++;
-    }
+    // Simulation Init
+    SimConfig config;
+    config.seed = (unsigned int)time(NULL);
+    sim.Init(config);
+    actionLog.Begin(config, (float)GetFixedTimeStep());
+    recording = true;
     // end
-
-    // Mountains
-    int mountaiCount = 1 + rand() % 5;
-    for (int k = 0; k < mountaiCount; k++) {
-        int centerI = rand() % GRID_H;
-        int centerJ = rand() % GRID_W;
-
-        int radius = 3 + rand() % 4;
-        float coreRadius = radius * 0.6f;
-
-        for (int i = centerI - radius; i <= centerI + radius; i++) {
-            for (int j = centerJ - radius; j <= centerJ + radius; j++) {
-                if (i < 0 || j < 0 || i >= GRID_H || j >= GRID_W) continue;
-                if (grid[i][j].type == CellType::Water) continue;
-
-                float di = float(i - centerI);
-                float dj = float(j - centerJ);
-                float dist = sqrtf(di * di + dj * dj);
-
-                if (dist > radius) continue;
-
-                if (dist <= coreRadius) {
-                    grid[i][j].type = CellType::Mountain;
-                }
-                else {
-                    float t = (dist - coreRadius) / (radius - coreRadius);
-                    float chance = 1.0f - t;
-                    float r = float(rand()) / RAND_MAX;
-                    if (r < chance) grid[i][j].type = CellType::Mountain;
-                }
-            }
-        }
-    }
-    // end
-
-    // Mountain Smoothing
-    std::vector<std::vector<Cell>> copy = grid;
-    for (int i = 1; i < GRID_H - 1; i++) {
-        for (int j = 1; j < GRID_W - 1; j++) {
-            if (grid[i][j].type == CellType::Water) continue;
-
-            int mountainCellCount = 0;
-            if (grid[i - 1][j].type == CellType::Mountain) mountainCellCount++;
-            if (grid[i + 1][j].type == CellType::Mountain) mountainCellCount++;
-            if (grid[i][j - 1].type == CellType::Mountain) mountainCellCount++;
-            if (grid[i][j + 1].type == CellType::Mountain) mountainCellCount++;
-
-            if (mountainCellCount >= 3) copy[i][j].type = CellType::Mountain;
-            else if (mountainCellCount <= 1) copy[i][j].type = CellType::Grass;
-        }
-    }
-
-    grid = copy;
-    // end
-}
-
-/* =========================================================
- *  Grid helpers
- * ========================================================= */
-glm::vec3 TrainGame::CellToWorld(int i, int j) const
-{
-    float x = (j - GRID_W / 2) * CELL_SIZE + CELL_SIZE * 0.5f;
-    float z = (i - GRID_H / 2) * CELL_SIZE + CELL_SIZE * 0.5f;
-    return glm::vec3(x, 0.0f, z);
-}
-
-bool TrainGame::WorldToCell(const glm::vec3& p, int& i, int& j) const
-{
-    j = int((p.x + GRID_W * CELL_SIZE / 2) / CELL_SIZE);
-    i = int((p.z + GRID_H * CELL_SIZE / 2) / CELL_SIZE);
-    return !(i < 0 || j < 0 || i >= GRID_H || j >= GRID_W);
 }
 
-
 /* =========================================================
  *  Frame Start/End + Update
  * ========================================================= */
@@ -232,135 +120,50 @@ void TrainGame::FrameStart()
     glViewport(0, 0, res.x, res.y);
 }
 
+void TrainGame::FixedUpdate(float step)
+{
+    // ***** SIMULATION *****
+    sim.Tick(step);
+    actionLog.Tick();
+}
+
 void TrainGame::Update(float dt)
 {
     // ***** FAIL STATE DETECTION *****
-    if (gameOver) {
+    if (sim.IsGameOver()) {
         std::string text1 = "GAME OVER";
-        std::string text2 = "Passengers delivered: " + std::to_string(totalDeliveredPassengers);
+        std::string text2 = "Passengers delivered: " + std::to_string(sim.GetDeliveredPassengers());
         std::string text3 = "Press SPACE to try again";
 
-        auto resolution = window->GetResolution();
-
         textRenderer->RenderText(text1, 420, 260, 1.5f, glm::vec3(1, 0, 0));
         textRenderer->RenderText(text2, 330, 340, 1.0f, glm::vec3(1, 1, 1));
         textRenderer->RenderText(text3, 445, 420, 0.5f, glm::vec3(1, 1, 1));
         return;
     }
 
-    if (stationFullnessTimers.size() != stations.size()) {
-        stationFullnessTimers.resize(stations.size(), 0.0f);
-    }
-
-    bool allStationsSafe = true;
-    for (size_t i = 0; i < stations.size(); i++) {
-        bool isFull = (stations[i].waitingPassengers.size() >= 10);
-        if (isFull) {
-            stationFullnessTimers[i] += dt;
-
-            if (stationFullnessTimers[i] > stationMaxFullnessTimer) {
-                allStationsSafe = false;
-            }
-        }
-        else {
-            stationFullnessTimers[i] = 0.0f;
-        }
-    }
-
-    if (!allStationsSafe) {
-        gameOver = true;
-    }
-
     // ***** SCORE AND INFO TEXT *****
-    std::string pointsText = "Points: " + std::to_string(currentPoints);
+    std::string pointsText = "Points: " + std::to_string(sim.GetPoints());
     textRenderer->RenderText(pointsText, 10, 10, 0.5f, glm::vec3(1, 1, 1));
 
-    gameTime += dt;
-    int minutes = (int)gameTime / 60;
-    int seconds = (int)gameTime % 60;
+    int minutes = (int)sim.GetGameTime() / 60;
+    int seconds = (int)sim.GetGameTime() % 60;
     std::string timeText = "Time: " + std::to_string(minutes) + ":" + std::to_string(seconds);
     textRenderer->RenderText(timeText, 10, 50, 0.5f, glm::vec3(1, 1, 1));
 
-    // ***** SPAWN STATION *****
-    stationSpawnTimer += dt;
-    if (stationSpawnTimer >= stationSpawnInterval) {
-        stationSpawnTimer = 0.0f;
-        SpawnRandomStation();
+    if (GetTimeScale() != 1.0) {
+        std::string speedText = "Speed: x" + std::to_string((int)GetTimeScale());
+        textRenderer->RenderText(speedText, 10, 90, 0.5f, glm::vec3(1, 1, 1));
     }
 
-    // ***** UPDATE PASSANGERS *****
-    static float passengerTimer = 0.0f;
-    passengerTimer += dt;
-    if (passengerTimer > passengerSpawnInterval)
-    {
-        for (const auto& s : stations)
-        {
-            if (s.shape == StationShape::Circle) circleExists = true;
-            if (s.shape == StationShape::Square) squareExists = true;
-            if (s.shape == StationShape::Pyramid) pyramidExists = true;
-        }
-
-        passengerTimer = 0.0f;
-
-        for (auto& s : stations)
-        {
-            if ((int)s.waitingPassengers.size() >= 10) continue;
-
-            Passenger p;
-            int r = rand() % 3;
-            p.type = (StationShape)r;
-
-            if (p.type == s.shape) continue;
-            
-            if (p.type == StationShape::Pyramid && pyramidExists
-                || p.type == StationShape::Circle && circleExists
-                || p.type == StationShape::Square && squareExists)
-                s.waitingPassengers.push_back(p);
-        }
-    }
-
-    // ***** UPDATE TRAINS *****
-    UpdateGridTrains(dt);
-
     // ***** GRID RENDER *****
     RenderGrid();
     RenderGridRails();
 
     // ***** TRAIN AND WAGON RENDER *****
-    for (auto& t : gridTrains)
-    {
-        if (t.trail.size() < 2) continue;
-
-        glm::vec3 locoPos = t.trail[0];
-        glm::vec3 locoDir = glm::normalize(t.trail[0] - t.trail[1]);
-
-        RenderLocomotive(locoPos, locoDir);
-
-        float distAccum = 0.f;
-        int wagonIndex = 0;
-        float targetDist = locomotiveLength;
-
-        for (int k = 1; k < (int)t.trail.size() && wagonIndex < t.wagons; k++)
-        {
-            float d = glm::distance(t.trail[k - 1], t.trail[k]);
-            distAccum += d;
-
-            if (distAccum >= targetDist)
-            {
-                glm::vec3 wagonPos = t.trail[k];
-                glm::vec3 wagonDir = glm::normalize(t.trail[k - 1] - t.trail[k]);
-
-                RenderWagon(wagonPos, wagonDir);
-                RenderWagonPassengers(t, wagonIndex, wagonPos, wagonDir);
-
-                wagonIndex++;
-                targetDist += wagonSpacing;
-            }
-        }
-    }
+    RenderTrains();
 
     // ***** STATIONS *****
-    for (auto& s : stations) {
+    for (int s = 0; s < sim.GetStations().Count(); s++) {
         RenderStation(s);
         RenderStationPassengers(s);
     }
@@ -380,19 +183,47 @@ void TrainGame::RenderGrid()
     const glm::vec3 water(0.20f, 0.40f, 0.80f);
     const glm::vec3 mountain(0.55f, 0.55f, 0.55f);
 
-    for (int i = 0; i < GRID_H; i++) {
-        for (int j = 0; j < GRID_W; j++) {
-            glm::vec3 pos = CellToWorld(i, j);
+    const float CELL_SIZE = TrainSim::CELL_SIZE;
+    const ChunkedGrid<Cell>& grid = sim.GetGrid();
+
+    for (int cr = 0; cr < grid.ChunksY(); cr++) {
+        for (int cc = 0; cc < grid.ChunksX(); cc++) {
+            const auto& chunk = grid.GetChunk(cr, cc);
+            int i0, j0, i1, j1;
+            grid.ChunkCellRange(cr, cc, i0, j0, i1, j1);
+
+            // A uniform chunk is drawn as a single box covering all its cells
+            if (chunk.IsUniform()) {
+                glm::vec3 color = grass;
+                if (chunk.uniform.Type() == CellType::Water) color = water;
+                else if (chunk.uniform.Type() == CellType::Mountain) color = mountain;
+
+                glm::vec3 pos = (sim.CellToWorld(i0, j0) + sim.CellToWorld(i1 - 1, j1 - 1)) * 0.5f;
 
-            glm::vec3 color = grass;
-            if (grid[i][j].type == CellType::Water) color = water;
-            else if (grid[i][j].type == CellType::Mountain) color = mountain;
+                glm::mat4 m(1);
+                m = glm::translate(m, pos + glm::vec3(0, -0.02f, 0));
+                m = glm::scale(m, glm::vec3((j1 - j0) * CELL_SIZE, 0.02f, (i1 - i0) * CELL_SIZE));
 
-            glm::mat4 m(1);
-            m = glm::translate(m, pos + glm::vec3(0, -0.02f, 0));
-            m = glm::scale(m, glm::vec3(CELL_SIZE, 0.02f, CELL_SIZE));
+                RenderMeshColor(meshes["box"], m, color);
+                continue;
+            }
+
+            for (int i = i0; i < i1; i++) {
+                for (int j = j0; j < j1; j++) {
+                    glm::vec3 pos = sim.CellToWorld(i, j);
+                    const Cell& cell = grid.At(i, j);
+
+                    glm::vec3 color = grass;
+                    if (cell.Type() == CellType::Water) color = water;
+                    else if (cell.Type() == CellType::Mountain) color = mountain;
 
-            RenderMeshColor(meshes["box"], m, color);
+                    glm::mat4 m(1);
+                    m = glm::translate(m, pos + glm::vec3(0, -0.02f, 0));
+                    m = glm::scale(m, glm::vec3(CELL_SIZE, 0.02f, CELL_SIZE));
+
+                    RenderMeshColor(meshes["box"], m, color);
+                }
+            }
         }
     }
 }
@@ -403,29 +234,79 @@ void TrainGame::RenderGridRails()
     const glm::vec3 bridgeColor(0.9f, 0.9f, 0.6f);
     const glm::vec3 tunnelColor(0.35f, 0.35f, 0.35f);
 
-    for (int i = 0; i < GRID_H; i++) {
-        for (int j = 0; j < GRID_W; j++) {
-
-            unsigned char m = grid[i][j].railMask;
-            if (m == 0) continue;
+    const float CELL_SIZE = TrainSim::CELL_SIZE;
+    const ChunkedGrid<Cell>& grid = sim.GetGrid();
+
+    for (int cr = 0; cr < grid.ChunksY(); cr++) {
+        for (int cc = 0; cc < grid.ChunksX(); cc++) {
+            if (sim.GetChunkRailCells(cr, cc) == 0) continue;
+
+            int i0, j0, i1, j1;
+            grid.ChunkCellRange(cr, cc, i0, j0, i1, j1);
+
+            // Only visit the cells of each row that hold rails
+            for (int i = i0; i < i1; i++) {
+                for (uint64_t rails = RailCells(grid, i, cc); rails; rails &= rails - 1) {
+                    int j = j0 + LowestBit(rails);
+                    const Cell& cell = grid.At(i, j);
+                    unsigned char m = cell.RailMask();
+
+                    glm::vec3 basePos = sim.CellToWorld(i, j);
+                    glm::vec3 color = normalColor;
+                    float height = 0.02f;
+                    if (cell.RailType() == RailVisualType::Bridge) {
+                        height = 0.06f;
+                        color = bridgeColor;
+                    }
+                    else if (cell.RailType() == RailVisualType::Tunnel) {
+                        height = -0.02f;
+                        color = tunnelColor;
+                    }
 
-            glm::vec3 basePos = CellToWorld(i, j);
-            glm::vec3 color = normalColor;
-            float height = 0.02f;
-            if (grid[i][j].railType == RailVisualType::Bridge) {
-                height = 0.06f;
-                color = bridgeColor;
-            }
-            else if (grid[i][j].railType == RailVisualType::Tunnel) {
-                height = -0.02f;
-                color = tunnelColor;
+                    float o = CELL_SIZE * 0.25f;
+                    if (m & UP) RenderRailSegment(basePos, glm::vec3(0, 0, -o), height, RADIANS(90), color);
+                    if (m & DOWN) RenderRailSegment(basePos, glm::vec3(0, 0, +o), height, RADIANS(90), color);
+                    if (m & LEFT) RenderRailSegment(basePos, glm::vec3(-o, 0, 0), height, 0.0f, color);
+                    if (m & RIGHT) RenderRailSegment(basePos, glm::vec3(+o, 0, 0), height, 0.0f, color);
+                }
             }
+        }
+    }
+}
+
+void TrainGame::RenderTrains()
+{
+    const TrainStore& trains = sim.GetTrains();
+
+    // The sim is ahead of the frame by the unused part of a step, so draw
+    // every train that much further back along its trail
+    float lagSteps = 1.0f - GetInterpolationAlpha();
 
-            float o = CELL_SIZE * 0.25f;
-            if (m & UP) RenderRailSegment(basePos, glm::vec3(0, 0, -o), height, RADIANS(90), color);
-            if (m & DOWN) RenderRailSegment(basePos, glm::vec3(0, 0, +o), height, RADIANS(90), color);
-            if (m & LEFT) RenderRailSegment(basePos, glm::vec3(-o, 0, 0), height, 0.0f, color);
-            if (m & RIGHT) RenderRailSegment(basePos, glm::vec3(+o, 0, 0), height, 0.0f, color);
+    for (int k = 0; k < trains.Count(); k++)
+    {
+        const TrainTrail& trail = trains.trail[k];
+        float lag = lagSteps * trains.moved[k] * TrainSim::CELL_SIZE;
+
+        glm::vec3 head = sim.GetTrainPos(k);
+        glm::vec3 locoPos, locoDir;
+        if (!trail.At(head, lag, locoPos, locoDir)) {
+            lag = 0.0f;
+            locoPos = head;
+            locoDir = sim.GetTrainDir(k);
+        }
+
+        RenderLocomotive(locoPos, locoDir);
+
+        float targetDist = lag + TrainSim::LOCOMOTIVE_LENGTH;
+        for (int wagonIndex = 0; wagonIndex < trains.wagons[k]; wagonIndex++)
+        {
+            glm::vec3 wagonPos, wagonDir;
+            if (!trail.At(head, targetDist, wagonPos, wagonDir)) break;
+
+            RenderWagon(wagonPos, wagonDir);
+            RenderWagonPassengers(trains.passengers[k], wagonIndex, wagonPos, wagonDir);
+
+            targetDist += TrainSim::WAGON_SPACING;
         }
     }
 }
@@ -461,7 +342,7 @@ void TrainGame::RenderRailSegment(
     glm::mat4 mtx(1);
     mtx = glm::translate(mtx, basePos + offset + glm::vec3(0, height, 0));
     mtx = glm::rotate(mtx, rotY, glm::vec3(0, 1, 0));
-    mtx = glm::scale(mtx, glm::vec3(CELL_SIZE * 0.5f, 0.03f, CELL_SIZE * 0.15f));
+    mtx = glm::scale(mtx, glm::vec3(TrainSim::CELL_SIZE * 0.5f, 0.03f, TrainSim::CELL_SIZE * 0.15f));
     RenderMeshColor(meshes["box"], mtx, color);
 }
 
@@ -513,28 +394,31 @@ void TrainGame::DrawCylinderPart(const glm::vec3& basePos, float yaw,
 /* =========================================================
  *  Station / Rail / Train rendering
  * ========================================================= */
-void TrainGame::RenderStation(const Station& s)
+void TrainGame::RenderStation(int s)
 {
+    const StationStore& stations = sim.GetStations();
+    StationShape shape = stations.shape[s];
+
     glm::vec3 color;
-    if (s.shape == StationShape::Circle) color = glm::vec3(0.2f, 0.7f, 0.95f);
-    else if (s.shape == StationShape::Square) color = glm::vec3(0.95f, 0.65f, 0.2f);
+    if (shape == StationShape::Circle) color = glm::vec3(0.2f, 0.7f, 0.95f);
+    else if (shape == StationShape::Square) color = glm::vec3(0.95f, 0.65f, 0.2f);
     else color = glm::vec3(0.3f, 0.95f, 0.25f);
 
     glm::mat4 m(1);
-    m = glm::translate(m, s.pos + glm::vec3(0, 0.25f, 0));
+    m = glm::translate(m, stations.pos[s] + glm::vec3(0, 0.25f, 0));
     m = glm::scale(m, glm::vec3(0.5f));
 
-    float fullness = std::min((float)s.waitingPassengers.size() / 10.0f, 1.0f);
+    float fullness = std::min((float)stations.waiting[s].total / 10.0f, 1.0f);
 
-    if (s.shape == StationShape::Circle) RenderMeshColor(meshes["sphere"], m, color, fullness);
-    else if (s.shape == StationShape::Pyramid) RenderMeshColor(meshes["pyramid"], m, color, fullness);
+    if (shape == StationShape::Circle) RenderMeshColor(meshes["sphere"], m, color, fullness);
+    else if (shape == StationShape::Pyramid) RenderMeshColor(meshes["pyramid"], m, color, fullness);
     else RenderMeshColor(meshes["box"], m, color, fullness);
 }
 
 void TrainGame::RenderLocomotive(const glm::vec3& pos, const glm::vec3& dir)
 {
     float yaw = atan2(-dir.z, dir.x);
-    glm::vec3 basePos = pos + glm::vec3(0, TRAIN_Y_OFFSET, 0);
+    glm::vec3 basePos = pos + glm::vec3(0, TrainSim::TRAIN_Y_OFFSET, 0);
 
     DrawBoxPart(basePos, yaw, glm::vec3(-0.12f, 0.125f, 0), glm::vec3(1.2f, 0.05f, 0.4f), glm::vec3(1, 1, 0));
     DrawBoxPart(basePos, yaw, glm::vec3(-0.5f, 0.35f, 0), glm::vec3(0.45f, 0.4f, 0.4f), glm::vec3(0, 1, 0));
@@ -551,7 +435,7 @@ void TrainGame::RenderLocomotive(const glm::vec3& pos, const glm::vec3& dir)
 void TrainGame::RenderWagon(const glm::vec3& pos, const glm::vec3& dir)
 {
     float yaw = atan2(-dir.z, dir.x);
-    glm::vec3 basePos = pos + glm::vec3(0, TRAIN_Y_OFFSET, 0);
+    glm::vec3 basePos = pos + glm::vec3(0, TrainSim::TRAIN_Y_OFFSET, 0);
 
     DrawBoxPart(basePos, yaw, glm::vec3(0.0f, 0.125f, 0), glm::vec3(1.0f, 0.05f, 0.4f), glm::vec3(1, 1, 0 ));
     DrawBoxPart(basePos,yaw, glm::vec3(0.0f, 0.325f, 0), glm::vec3(1.0f, 0.45f, 0.4f), glm::vec3(0, 1.0f, 0));
@@ -563,31 +447,37 @@ void TrainGame::RenderWagon(const glm::vec3& pos, const glm::vec3& dir)
     }
 }
 
-void TrainGame::RenderStationPassengers(const Station& s)
+void TrainGame::RenderStationPassengers(int s)
 {
+    const PassengerCounts& waiting = sim.GetStations().waiting[s];
     float spacing = 0.15f;
-    glm::vec3 basePos = s.pos + glm::vec3(-0.3f, 0.6f, -0.08f);
+    glm::vec3 basePos = sim.GetStations().pos[s] + glm::vec3(-0.3f, 0.6f, -0.08f);
 
-    for (int i = 0; i < (int)s.waitingPassengers.size(); i++)
+    // Grouped by shape; only the first rows fit on the platform
+    int i = 0;
+    for (int shape = 0; shape < SHAPE_COUNT; shape++)
     {
-        glm::vec3 p = basePos + glm::vec3((i % 5) * spacing, 0, (i / 5) * spacing);
-        RenderPassenger(p, s.waitingPassengers[i]);
+        for (int n = 0; n < waiting.byShape[shape] && i < 10; n++, i++)
+        {
+            glm::vec3 p = basePos + glm::vec3((i % 5) * spacing, 0, (i / 5) * spacing);
+            RenderPassenger(p, (StationShape)shape);
+        }
     }
 }
 
-void TrainGame::RenderPassenger(const glm::vec3& pos, const Passenger& p)
+void TrainGame::RenderPassenger(const glm::vec3& pos, StationShape type)
 {
     glm::mat4 m(1);
     m = glm::translate(m, pos);
     m = glm::scale(m, glm::vec3(0.12f));
 
-    if (p.type == StationShape::Circle) RenderMeshColor(meshes["sphere"], m, { 0.2f,0.7f,1 });
-    else if (p.type == StationShape::Square) RenderMeshColor(meshes["box"], m, { 1,0.7f,0.2f });
+    if (type == StationShape::Circle) RenderMeshColor(meshes["sphere"], m, { 0.2f,0.7f,1 });
+    else if (type == StationShape::Square) RenderMeshColor(meshes["box"], m, { 1,0.7f,0.2f });
     else RenderMeshColor(meshes["pyramid"], m, { 0.3f,1,0.3f });
 }
 
 void TrainGame::RenderWagonPassengers(
-    const GridTrain& t,
+    const PassengerCounts& passengers,
     int wagonIndex,
     const glm::vec3& wagonPos,
     const glm::vec3& wagonDir)
@@ -599,11 +489,15 @@ void TrainGame::RenderWagonPassengers(
     float spacingX = 0.18f;
     float spacingZ = 0.18f;
 
+    // Passengers fill the wagons grouped by shape, six to a wagon
     int startPassenger = wagonIndex * 6;
-    int endPassenger = std::min(startPassenger + 6, (int)t.passengers.size());
+    int endPassenger = std::min(startPassenger + 6, passengers.total);
 
+    int shape = 0;
+    int shapeEnd = passengers.byShape[0];
     for (int i = startPassenger; i < endPassenger; i++)
     {
+        while (i >= shapeEnd) shapeEnd += passengers.byShape[++shape];
         int local = i - startPassenger;
 
         int row = local / 3;
@@ -618,7 +512,7 @@ void TrainGame::RenderWagonPassengers(
             right * zOffset +
             glm::vec3(0, startHeight, 0);
 
-        RenderPassenger(pos, t.passengers[i]);
+        RenderPassenger(pos, (StationShape)shape);
     }
 }
 
@@ -645,558 +539,6 @@ glm::vec3 TrainGame::ScreenToWorldOnGround(int mouseX, int mouseY)
     return origin + dir * t;
 }
 
-/* =========================================================
- *  Station 
- * ========================================================= */
-bool TrainGame::IsValidStationCell(int i, int j) const
-{
-    if (grid[i][j].type != CellType::Grass) return false;
-    if (grid[i][j].hasStation) return false;
-    if (i == 0 || i == GRID_W - 1) return false;
-    if (j == 0 || j == GRID_H - 1) return false;
-
-    glm::vec3 pos = CellToWorld(i, j);
-    for (auto& s : stations)
-        if (glm::distance(s.pos, pos) < CELL_SIZE * 2.0f)
-            return false;
-
-    return true;
-}
-
-bool TrainGame::SpawnRandomStation()
-{
-    const int MAX_TRIES = 100;
-
-    for (int t = 0; t < MAX_TRIES; t++) {
-        int i = rand() % GRID_H;
-        int j = rand() % GRID_W;
-
-        if (!IsValidStationCell(i, j))
-            continue;
-
-        glm::vec3 pos = CellToWorld(i, j);
-
-        StationShape shape;
-        int shapeTypeChance = rand() % 3;
-        if (shapeTypeChance == 0) shape = StationShape::Square;
-        else if (shapeTypeChance == 1) shape = StationShape::Circle;
-        else shape = StationShape::Pyramid;
-
-        AddStation(pos, shape);
-        grid[i][j].hasStation = true;
-
-        return true;
-    }
-
-    return false;
-}
-
-void TrainGame::AddStation(const glm::vec3& pos, StationShape shape)
-{
-    Station s;
-    s.id = (int)stations.size();
-    s.pos = pos;
-    s.shape = shape;
-    stations.push_back(s);
-}
-
-
-int TrainGame::PickStationAt(const glm::vec3& p) const
-{
-    for (auto& s : stations)
-        if (glm::distance(s.pos, p) < pickRadius)
-            return s.id;
-    return -1;
-}
-
-int TrainGame::GetStationAtCell(int i, int j)
-{
-    for (auto& s : stations)
-    {
-        int si, sj;
-        WorldToCell(s.pos, si, sj);
-        if (si == i && sj == j)
-            return s.id;
-    }
-    return -1;
-}
-
-/* =========================================================
- *  Train Spawning and Updating
- * ========================================================= */
-int TrainGame::SpawnTrainAtCell(int i, int j)
-{
-    for (auto& t : gridTrains)
-        if (t.i == i && t.j == j)
-            return -1;
-
-    GridTrain t;
-    t.i = i;
-    t.j = j;
-    t.progress = 0.0f;
-    t.dir = 0;
-
-    glm::vec3 pos = GetTrainPos(t);
-    for (int k = 0; k < 20; k++)
-        t.trail.push_back(pos);
-
-    unsigned char m = grid[i][j].railMask;
-    if (m & UP) t.dir = 0;
-    else if (m & RIGHT) t.dir = 1;
-    else if (m & DOWN) t.dir = 2;
-    else if (m & LEFT) t.dir = 3;
-
-    gridTrains.push_back(t);
-
-    return gridTrains.size() - 1;
-}
-
-void TrainGame::UpdateGridTrains(float dt)
-{
-    float speed = 2.0f;
-
-    for (auto& t : gridTrains)
-    {
-        if (t.stopping)
-        {
-            t.stopTimer += dt;
-
-            if (t.stopTimer >= 0.5f)
-            {
-                t.stopTimer = 0.0f;
-                ProcessStationPassengers(t);
-            }
-
-            continue;
-        }
-
-        t.progress += dt * speed;
-
-        while (t.progress >= 1.0f)
-        {
-            t.progress -= 1.0f;
-
-            int ni = t.i + di[t.dir];
-            int nj = t.j + dj[t.dir];
-
-            if (ni < 0 || nj < 0 || ni >= GRID_H || nj >= GRID_W ||
-                grid[ni][nj].railMask == 0)
-            {
-                t.dir = OppositeDir(t.dir);
-                ResetTrainTrail(t);
-                break;
-            }
-
-            t.i = ni;
-            t.j = nj;
-
-            int stationId = GetStationAtCell(t.i, t.j);
-            if (stationId >= 0)
-            {
-                bool hasPassengersToDrop = false;
-                bool canPickUpPassengers = false;
-
-                for (const auto& passenger : t.passengers)
-                {
-                    if (passenger.type == stations[stationId].shape)
-                    {
-                        hasPassengersToDrop = true;
-                        break;
-                    }
-                }
-
-                if (t.passengers.size() < TrainCapacity(t) &&
-                    !stations[stationId].waitingPassengers.empty())
-                {
-                    canPickUpPassengers = true;
-                }
-
-                if (hasPassengersToDrop || canPickUpPassengers)
-                {
-                    StartStationStop(t, stationId);
-                    break;
-                }
-                else
-                {
-                    t.dir = ChooseNextDirection(t.i, t.j, t.dir);
-                    continue;
-                }
-            }
-
-            t.dir = ChooseNextDirection(t.i, t.j, t.dir);
-        }
-
-        UpdateTrainTrail(t);
-    }
-}
-
-void TrainGame::ResetTrainTrail(GridTrain& t)
-{
-    t.trail.clear();
-    glm::vec3 pos = GetTrainPos(t);
-    for (int k = 0; k < 30; k++)
-        t.trail.push_back(pos);
-}
-
-void TrainGame::UpdateTrainTrail(GridTrain& t)
-{
-    glm::vec3 pos = GetTrainPos(t);
-    t.trail.push_front(pos);
-    if (t.trail.size() > 500) t.trail.pop_back();
-}
-
-int TrainGame::ChooseNextDirection(int i, int j, int currentDir)
-{
-    unsigned char mask = grid[i][j].railMask;
-    int backDir = OppositeDir(currentDir);
-
-    if (mask & DirToMask(currentDir))
-        return currentDir;
-
-    for (int d = 0; d < 4; d++) {
-        if (d == backDir) continue;
-        if (mask & DirToMask(d))
-            return d;
-    }
-
-    return backDir;
-}
-
-void TrainGame::ProcessStationPassengers(GridTrain& train)
-{
-    Station& station = stations[train.stationId];
-
-    // Descarcare
-    if (train.unloadIndex < (int)train.passengers.size())
-    {
-        Passenger& p = train.passengers[train.unloadIndex];
-
-        bool delivered =
-            (station.shape == StationShape::Circle && p.type == StationShape::Circle) ||
-            (station.shape == StationShape::Square && p.type == StationShape::Square) ||
-            (station.shape == StationShape::Pyramid && p.type == StationShape::Pyramid);
-
-        if (delivered) {
-            totalDeliveredPassengers++;
-            currentPoints++;
-            train.passengers.erase(train.passengers.begin() + train.unloadIndex);
-        }
-        else train.unloadIndex++;
-
-        return;
-    }
-    // end
-
-    // Incarcare
-    if (!station.waitingPassengers.empty() &&
-        (int)train.passengers.size() < TrainCapacity(train))
-    {
-        train.passengers.push_back(station.waitingPassengers.back());
-        station.waitingPassengers.pop_back();
-        return;
-    }
-    // end
-
-    // Plecare
-    train.stopping = false;
-    train.stationId = -1;
-    train.unloadIndex = 0;
-    train.dir = ChooseNextDirection(train.i, train.j, train.dir);
-    // end
-}
-
-void TrainGame::StartStationStop(GridTrain& train, int stationId)
-{
-    train.stopping = true;
-    train.stationId = stationId;
-    train.stopTimer = 0.0f;
-    train.unloadIndex = 0;
-}
-
-/* =========================================================
- *  Train Positioning, Direction and Misc. Info
- * ========================================================= */
-glm::vec3 TrainGame::GetTrainPos(const GridTrain& t)
-{
-    glm::vec3 p1 = CellToWorld(t.i, t.j);
-
-    int ni = t.i + di[t.dir];
-    int nj = t.j + dj[t.dir];
-
-    glm::vec3 p2 = p1;
-    if (ni >= 0 && nj >= 0 && ni < GRID_H && nj < GRID_W) p2 = CellToWorld(ni, nj);
-
-    return glm::mix(p1, p2, t.progress) + glm::vec3(0, TRAIN_Y_OFFSET, 0);
-}
-
-glm::vec3 TrainGame::GetTrainDir(const GridTrain& t)
-{
-    glm::vec3 p1 = CellToWorld(t.i, t.j);
-
-    int ni = t.i + di[t.dir];
-    int nj = t.j + dj[t.dir];
-
-    glm::vec3 p2 = p1;
-    if (ni >= 0 && nj >= 0 && ni < GRID_H && nj < GRID_W) p2 = CellToWorld(ni, nj);
-
-    glm::vec3 d = p2 - p1;
-    d.y = 0;
-    if (glm::length(d) < 0.001f) return glm::vec3(1, 0, 0);
-
-    return glm::normalize(d);
-}
-
-int TrainGame::PickGridTrainAt(const glm::vec3& p)
-{
-    for (int i = 0; i < (int)gridTrains.size(); i++)
-    {
-        glm::vec3 tp = CellToWorld(gridTrains[i].i, gridTrains[i].j);
-        if (glm::distance(tp, p) < CELL_SIZE * 0.4f) return i;
-    }
-    return -1;
-}
-
-int TrainGame::TrainCapacity(const GridTrain& t)
-{
-    return t.wagons * 6;
-}
-
-/* =========================================================
- *  Rail Construction and Deletion
- * ========================================================= */
-void TrainGame::HandleStationConnection(int ci, int cj, const glm::vec3& hit)
-{
-    int stationId = PickStationAt(hit);
-    if (stationId < 0) return;
-
-    if (selectedStation < 0) {
-        selectedStation = stationId;
-        return;
-    }
-
-    if (selectedStation == stationId) {
-        selectedStation = -1;
-        return;
-    }
-
-    BuildRailPath(selectedStation, stationId);
-    selectedStation = -1;
-}
-
-void TrainGame::BuildRailPath(int startStationId, int endStationId)
-{
-    int si, sj, ei, ej;
-    if (!WorldToCell(stations[startStationId].pos, si, sj) ||
-        !WorldToCell(stations[endStationId].pos, ei, ej))
-    {
-        return;
-    }
-
-    std::vector<std::pair<int, int>> path;
-    if (!FindPathBFS(si, sj, ei, ej, path))
-    {
-        return;
-    }
-
-    auto tempMask = grid;
-    for (int k = 0; k + 1 < (int)path.size(); k++)
-    {
-        int i1 = path[k].first;
-        int j1 = path[k].second;
-        int i2 = path[k + 1].first;
-        int j2 = path[k + 1].second;
-
-        unsigned char m1 = 0, m2 = 0;
-
-        if (i2 == i1 && j2 == j1 + 1) { m1 = RIGHT; m2 = LEFT; }
-        else if (i2 == i1 && j2 == j1 - 1) { m1 = LEFT; m2 = RIGHT; }
-        else if (i2 == i1 + 1 && j2 == j1) { m1 = DOWN; m2 = UP; }
-        else if (i2 == i1 - 1 && j2 == j1) { m1 = UP; m2 = DOWN; }
-
-        unsigned char newMask1 = tempMask[i1][j1].railMask | m1;
-        unsigned char newMask2 = tempMask[i2][j2].railMask | m2;
-
-        if (CountBits(newMask1) == 3 || CountBits(newMask2) == 3)
-        {
-            return;
-        }
-
-        tempMask[i1][j1].railMask = newMask1;
-        tempMask[i2][j2].railMask = newMask2;
-    }
-
-    for (int k = 0; k + 1 < (int)path.size(); k++)
-    {
-        int i1 = path[k].first;
-        int j1 = path[k].second;
-        int i2 = path[k + 1].first;
-        int j2 = path[k + 1].second;
-
-        unsigned char m1 = 0, m2 = 0;
-
-        if (i2 == i1 && j2 == j1 + 1) { m1 = RIGHT; m2 = LEFT; }
-        else if (i2 == i1 && j2 == j1 - 1) { m1 = LEFT; m2 = RIGHT; }
-        else if (i2 == i1 + 1 && j2 == j1) { m1 = DOWN; m2 = UP; }
-        else if (i2 == i1 - 1 && j2 == j1) { m1 = UP; m2 = DOWN; }
-
-        grid[i1][j1].railMask |= m1;
-        grid[i2][j2].railMask |= m2;
-
-        if (grid[i2][j2].type == CellType::Water)
-            grid[i2][j2].railType = RailVisualType::Bridge;
-        else if (grid[i2][j2].type == CellType::Mountain)
-            grid[i2][j2].railType = RailVisualType::Tunnel;
-    }
-}
-
-void TrainGame::EraseRailFromCell(int si, int sj)
-{
-    if (grid[si][sj].railMask == 0)  return;
-
-    unsigned char m = grid[si][sj].railMask;
-    for (int d = 0; d < 4; d++)
-        if (m & DirToMask(d))
-            EraseRailsInDirection(si, sj, d);
-}
-
-void TrainGame::EraseRailsInDirection(int si, int sj, int dir)
-{
-    int i = si;
-    int j = sj;
-    int curDir = dir;
-    while (true)
-    {
-        if (grid[i][j].hasStation) break;
-
-        unsigned char mask = grid[i][j].railMask;
-
-        grid[i][j].railMask &= ~DirToMask(curDir);
-
-        int ni = i + di[curDir];
-        int nj = j + dj[curDir];
-        if (ni < 0 || nj < 0 || ni >= GRID_H || nj >= GRID_W) break;
-
-        grid[ni][nj].railMask &= ~DirToMask(OppositeDir(curDir));
-
-        i = ni;
-        j = nj;
-        if (grid[i][j].railMask == 0) break;
-
-        unsigned char newMask = grid[i][j].railMask;
-        bool found = false;
-        for (int d = 0; d < 4; d++)
-        {
-            if (newMask & DirToMask(d))
-            {
-                curDir = d;
-                found = true;
-                break;
-            }
-        }
-
-        if (!found) break;
-    }
-}
-
-void TrainGame::RemoveTrainsOnBrokenRails()
-{
-    for (int k = (int)gridTrains.size() - 1; k >= 0; k--)
-    {
-        auto& t = gridTrains[k];
-        if (grid[t.i][t.j].railMask == 0) {
-            currentPoints += 10 + t.wagons * 5;
-            gridTrains.erase(gridTrains.begin() + k);
-        }
-    }
-}
-
-bool TrainGame::HasRailAt(int i, int j)
-{
-    return grid[i][j].railMask != 0;
-}
-
-/* =========================================================
- *  Game Restart
- * ========================================================= */
-void TrainGame::RestartGame()
-{
-    int di[4] = { -1, 0, 1, 0 };
-    int dj[4] = { 0, 1, 0, -1 };
-
-    grid.clear();
-    gridTrains.clear();
-    stations.clear();
-    stationFullnessTimers.clear();
-    selectedStation = -1;
-    gameOver = circleExists = squareExists = pyramidExists = false;
-    totalDeliveredPassengers = 0;
-    currentPoints = 15;
-    gameTime = 0;
-
-    InitGrid();
-
-    SpawnRandomStation();
-    SpawnRandomStation();
-}
-
-/* =========================================================
- *  BFS
- * ========================================================= */
-bool TrainGame::FindPathBFS(int si, int sj, int ti, int tj, std::vector<std::pair<int, int>>& outPath)
-{
-    std::vector<std::vector<bool>> visited(GRID_H, std::vector<bool>(GRID_W, false));
-    std::vector<std::vector<std::pair<int, int>>> parent(GRID_H, std::vector<std::pair<int, int>>(GRID_W, { -1, -1 }));
-    std::queue<std::pair<int, int>> q;
-
-    visited[si][sj] = true;
-    q.push({ si, sj });
-
-    const int di[4] = { -1, 1, 0, 0 };
-    const int dj[4] = { 0, 0, -1, 1 };
-
-    bool found = false;
-    while (!q.empty()) {
-        std::pair<int, int> cur = q.front();
-        q.pop();
-
-        int ci = cur.first;
-        int cj = cur.second;
-
-        if (ci == ti && cj == tj) {
-            found = true;
-            break;
-        }
-
-        for (int d = 0; d < 4; d++) {
-            int ni = ci + di[d];
-            int nj = cj + dj[d];
-
-            if (ni < 0 || nj < 0 || ni >= GRID_H || nj >= GRID_W) continue;
-
-            if (visited[ni][nj]) continue;
-
-            visited[ni][nj] = true;
-            parent[ni][nj] = { ci, cj };
-            q.push({ ni, nj });
-        }
-    }
-
-    if (!found) return false;
-
-    outPath.clear();
-    int ci = ti, cj = tj;
-    while (!(ci == si && cj == sj)) {
-        outPath.push_back({ ci, cj });
-        auto p = parent[ci][cj];
-        ci = p.first;
-        cj = p.second;
-    }
-    outPath.push_back({ si, sj });
-
-    std::reverse(outPath.begin(), outPath.end());
-    return true;
-}
-
 /* =========================================================
  *  Input callbacks
  * ========================================================= */
@@ -1220,7 +562,27 @@ void TrainGame::OnKeyPress(int key, int)
     if (key == GLFW_KEY_O)
         projectionMatrix = glm::ortho(left, right, bottom, top, zNear, zFar);
     if (key == GLFW_KEY_SPACE)
-        RestartGame();
+        Perform(PlayerAction::Restart());
+
+    // Fast-forward; the sim keeps its fixed step and just runs more of them
+    if (key == GLFW_KEY_1)
+        SetTimeScale(1);
+    if (key == GLFW_KEY_2)
+        SetTimeScale(10);
+    if (key == GLFW_KEY_3)
+        SetTimeScale(100);
+
+    // One quick-save slot next to the executable
+    if (key == GLFW_KEY_F5)
+        sim.SaveSnapshot(PATH_JOIN(window->props.selfDir, "train_game.snapshot"));
+    if (key == GLFW_KEY_F9 && sim.LoadSnapshot(PATH_JOIN(window->props.selfDir, "train_game.snapshot")))
+        recording = false;
+
+    // The hash is the one TrainSimCli --replay ends on
+    if (key == GLFW_KEY_F6 && recording && actionLog.Save(PATH_JOIN(window->props.selfDir, "train_game.replay"))) {
+        std::cout << "recorded " << actionLog.Ticks() << " ticks, state hash "
+            << std::hex << std::setw(16) << std::setfill('0') << sim.StateHash() << std::dec << std::endl;
+    }
 }
 
 void TrainGame::OnKeyRelease(int, int) {}
@@ -1238,35 +600,31 @@ void TrainGame::OnMouseBtnPress(int mx, int my, int button, int)
 {
     glm::vec3 hit = ScreenToWorldOnGround(mx, my);
     int ci, cj;
-    if (!WorldToCell(hit, ci, cj)) return;
+    if (!sim.WorldToCell(hit, ci, cj)) return;
 
     if (button == 1) {
-        int trainId = PickGridTrainAt(hit);
-        if (trainId >= 0) {
-            if (gridTrains[trainId].wagons < 5 && currentPoints >= 5) {
-                gridTrains[trainId].wagons++;
-                currentPoints -= 5;
-            }
+        TrainHandle train = sim.PickGridTrainAt(hit);
+        if (sim.GetTrains().Find(train) >= 0) {
+            Perform(PlayerAction::AddWagon(train.slot, train.generation));
         }
         else {
-            HandleStationConnection(ci, cj, hit);
+            Perform(PlayerAction::ConnectStation(hit));
         }
     }
     else if (button == 2) {
-        if (HasRailAt(ci, cj) && currentPoints >= 10) {
-            int trainId = SpawnTrainAtCell(ci, cj);
-            if (trainId != -1) gridTrains[trainId].wagons++;
-            currentPoints -= 15;
-        }
+        Perform(PlayerAction::AtCell(PlayerActionKind::PlaceTrain, ci, cj));
     }
     else if (button == 4) {
-        if (HasRailAt(ci, cj)) {
-            EraseRailFromCell(ci, cj);
-            RemoveTrainsOnBrokenRails();
-        }
+        Perform(PlayerAction::AtCell(PlayerActionKind::EraseRails, ci, cj));
     }
 }
 
+void TrainGame::Perform(const PlayerAction& action)
+{
+    actionLog.Record(action);
+    sim.Perform(action);
+}
+
 void TrainGame::OnMouseBtnRelease(int, int, int, int) {}
 void TrainGame::OnMouseScroll(int, int, int, int) {}
 void TrainGame::OnWindowResize(int, int) {}
@@ -1,4 +1,3 @@
-#include <ctime>
 #include <iostream>
 
 #include "core/engine.h"
@@ -23,8 +22,6 @@ std::string GetParentDir(const std::string &filePath)
 
 int main(int argc, char **argv)
 {
-    srand((unsigned int)time(NULL));
-
     // Create a window property structure
     WindowProperties wp;
     wp.resolution = glm::ivec2(1280, 720);